@@ -0,0 +1,48 @@
+# Writes OUTPUT, a header holding SOURCE as the zero terminated string NAME and, if SPIRV_NAME is set, the
+# file SPIRV as the byte array SPIRV_NAME. A missing SPIRV file gives an array of size zero. Run with
+# cmake -P by ocl_add_kernels().
+
+function(ocl_embed_bytes var name file terminate)
+    set(hex "")
+    if(file AND EXISTS "${file}")
+        file(READ "${file}" hex HEX)
+    endif()
+
+    string(LENGTH "${hex}" length)
+    math(EXPR size "${length} / 2")
+
+    set(data "${hex}")
+    if(terminate OR NOT size)
+        set(data "${data}00")
+    endif()
+
+    # CMake regular expressions have no counted repetition, spell out 16 bytes per line.
+    set(line "")
+    foreach(i RANGE 15)
+        set(line "${line}0x[0-9a-f][0-9a-f],")
+    endforeach()
+
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," data "${data}")
+    string(REGEX REPLACE "(${line})" "\\1\n    " data "${data}")
+
+    set(${var} "static const unsigned char ${name}_data[] =\n{\n    ${data}\n};\nstatic const size_t ${name}_size = ${size};\n" PARENT_SCOPE)
+endfunction()
+
+get_filename_component(file "${SOURCE}" NAME)
+
+ocl_embed_bytes(source ${NAME} "${SOURCE}" TRUE)
+set(text "// Generated by ocl_add_kernels() from ${file}, do not edit.\n#pragma once\n\n#include <cstddef>\n\n${source}static const char* const ${NAME} = (const char*)${NAME}_data;\n")
+
+if(SPIRV_NAME)
+    ocl_embed_bytes(spirv ${SPIRV_NAME} "${SPIRV}" FALSE)
+    set(text "${text}\n${spirv}static const unsigned char* const ${SPIRV_NAME} = ${SPIRV_NAME}_data;\n")
+endif()
+
+# Leave an unchanged header alone so dependents are not rebuilt.
+if(EXISTS "${OUTPUT}")
+    file(READ "${OUTPUT}" old)
+    if(old STREQUAL text)
+        return()
+    endif()
+endif()
+file(WRITE "${OUTPUT}" "${text}")
@@ -0,0 +1,107 @@
+# Offline kernel compilation helpers.
+#
+# ocl_add_spirv(<target> <file.cl>... [OPTIONS <clang options>...])
+#   Adds <target> compiling each OpenCL C file to <name>.spv in the current binary directory with clang
+#   and llvm-spirv, for CLProgram::CreateFromIL(). OCL_SPIRV_FOUND tells whether both tools were found,
+#   without them the function does nothing.
+#
+# ocl_add_kernels(<target> <file.cl>... [SPIRV] [OPTIONS <clang options>...])
+#   Embeds each OpenCL C file into a generated header <name>_<ext>.h on the include path of <target>,
+#   so kernels are built from memory and nothing is read from disk at startup. program.cl becomes
+#
+#     static const char* const program_cl;      // Zero terminated source
+#     static const size_t program_cl_size;
+#
+#   With SPIRV the header also holds the module compiled offline as program_spv and program_spv_size,
+#   for CLProgram::CreateFromIL(). Its size is zero if the SPIR-V tools were not found.
+
+find_program(OCL_CLANG NAMES clang)
+find_program(OCL_LLVM_SPIRV NAMES llvm-spirv)
+
+if(OCL_CLANG AND OCL_LLVM_SPIRV)
+    set(OCL_SPIRV_FOUND TRUE)
+else()
+    set(OCL_SPIRV_FOUND FALSE)
+    message(STATUS "clang or llvm-spirv not found, SPIR-V kernels are not built")
+endif()
+
+set(OCL_EMBED_SCRIPT "${CMAKE_CURRENT_LIST_DIR}/OCLEmbed.cmake")
+
+function(ocl_spirv_command source spirv)
+    get_filename_component(path "${source}" ABSOLUTE)
+    get_filename_component(name "${source}" NAME_WE)
+    get_filename_component(dir  "${spirv}" DIRECTORY)
+
+    set(bitcode "${dir}/${name}.bc")
+
+    add_custom_command(OUTPUT "${spirv}"
+        COMMAND ${OCL_CLANG} -c -cl-std=CL2.0 -target spir64 -emit-llvm -Xclang -finclude-default-header ${ARGN} -o "${bitcode}" "${path}"
+        COMMAND ${OCL_LLVM_SPIRV} "${bitcode}" -o "${spirv}"
+        DEPENDS "${path}"
+        COMMENT "Compiling ${name}.cl to SPIR-V"
+        VERBATIM)
+endfunction()
+
+function(ocl_add_spirv target)
+    cmake_parse_arguments(ARG "" "" "OPTIONS" ${ARGN})
+
+    if(NOT OCL_SPIRV_FOUND)
+        return()
+    endif()
+
+    set(outputs)
+    foreach(source ${ARG_UNPARSED_ARGUMENTS})
+        get_filename_component(name "${source}" NAME_WE)
+
+        set(spirv "${CMAKE_CURRENT_BINARY_DIR}/${name}.spv")
+        ocl_spirv_command("${source}" "${spirv}" ${ARG_OPTIONS})
+
+        list(APPEND outputs "${spirv}")
+    endforeach()
+
+    add_custom_target(${target} ALL DEPENDS ${outputs})
+endfunction()
+
+function(ocl_add_kernels target)
+    cmake_parse_arguments(ARG "SPIRV" "" "OPTIONS" ${ARGN})
+
+    set(dir "${CMAKE_CURRENT_BINARY_DIR}/${target}_kernels")
+    file(MAKE_DIRECTORY "${dir}")
+
+    set(headers)
+    foreach(source ${ARG_UNPARSED_ARGUMENTS})
+        get_filename_component(path "${source}" ABSOLUTE)
+        get_filename_component(file "${source}" NAME)
+        get_filename_component(name "${source}" NAME_WE)
+        string(MAKE_C_IDENTIFIER "${file}" symbol)
+
+        set(header  "${dir}/${symbol}.h")
+        set(depends "${path}" "${OCL_EMBED_SCRIPT}")
+        set(spirv)
+
+        if(ARG_SPIRV)
+            set(spirv -DSPIRV_NAME=${name}_spv)
+            if(OCL_SPIRV_FOUND)
+                ocl_spirv_command("${source}" "${dir}/${name}.spv" ${ARG_OPTIONS})
+                list(APPEND spirv -DSPIRV=${dir}/${name}.spv)
+                list(APPEND depends "${dir}/${name}.spv")
+            endif()
+        endif()
+
+        # The script leaves an unchanged header alone so its dependents are not rebuilt, the stamp records
+        # that it ran, otherwise the header stays older than its inputs and the command runs every build.
+        set(stamp "${header}.stamp")
+        add_custom_command(OUTPUT "${stamp}"
+            BYPRODUCTS "${header}"
+            COMMAND ${CMAKE_COMMAND} -DSOURCE=${path} -DOUTPUT=${header} -DNAME=${symbol} ${spirv} -P "${OCL_EMBED_SCRIPT}"
+            COMMAND ${CMAKE_COMMAND} -E touch "${stamp}"
+            DEPENDS ${depends}
+            COMMENT "Embedding ${file}"
+            VERBATIM)
+
+        list(APPEND headers "${header}" "${stamp}")
+    endforeach()
+
+    target_sources(${target} PRIVATE ${headers})
+    target_include_directories(${target} PUBLIC "${dir}")
+endfunction()
\ No newline at end of file
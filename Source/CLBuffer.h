@@ -2,8 +2,11 @@
 
 #include "CLContext.h"
 #include "CLFlags.h"
+#include "CLHazard.h"
 #include "CLMemMap.h"
+#include "CLQueue.h"
 #include <cstdint>
+#include <memory>
 #include <stdexcept>
 #include <utility>
 
@@ -14,7 +17,7 @@ class CLBuffer
     friend class CLBuffer;
 
 public:
-    CLBuffer() : mem(0), err(0), width(0), height(0), depth(0), pitch(0), slice(0)
+    CLBuffer() : mem(0), err(0), width(0), height(0), depth(0), pitch(0), slice(0), eventless(false)
     {
     }
     CLBuffer(cl_mem mem, cl_int err, size_t width, size_t height, size_t depth, size_t pitch, size_t slice) : CLBuffer()
@@ -57,6 +60,9 @@ public:
         std::swap(this->depth,  other.depth);
         std::swap(this->pitch,  other.pitch);
         std::swap(this->slice,  other.slice);
+        std::swap(this->hzd,    other.hzd);
+        std::swap(this->last,   other.last);
+        std::swap(this->eventless, other.eventless);
         return *this;
     }
     CLBuffer& operator=(const CLBuffer&) = delete;
@@ -76,7 +82,19 @@ public:
 
     void Wait() const
     {
-        this->err = this->evt.Wait();
+        CLWaitScope scope;
+        this->err = this->evt ? this->evt.Wait() : this->Finish();
+    }
+    // Returns the positive execution status without touching Error() if 'policy' timed out.
+    cl_int Wait(const CLWaitPolicy& policy) const
+    {
+        CLWaitScope scope;
+        auto status = this->evt ? this->evt.Wait(policy) : this->Finish();
+        if (status <= CL_SUCCESS)
+        {
+            this->err = status;
+        }
+        return status;
     }
 
     cl_int Error() const
@@ -89,6 +107,40 @@ public:
         return this->evt;
     }
 
+    // Opt-in hazard tracking: commands on this buffer wait for conflicting earlier commands by themselves.
+    void Track(bool enable)
+    {
+        if (!enable)
+        {
+            this->hzd.reset();
+        }
+        else if (!this->hzd)
+        {
+            this->hzd = std::make_shared<CLHazard>();
+        }
+    }
+    bool Tracked() const
+    {
+        return !!this->hzd;
+    }
+    const std::shared_ptr<CLHazard>& Hazard() const
+    {
+        return this->hzd;
+    }
+
+    // Opt-in event-less mode: reads, writes and copies on this buffer do not create events unless hazard
+    // tracking needs them. Event() is then empty and Wait() finishes the queue of the last command, order
+    // later commands through the in-order queue or a queue marker instead of wait lists. Maps keep their
+    // event since the mapped memory is only valid once it completed.
+    void Eventless(bool enable)
+    {
+        this->eventless = enable;
+    }
+    bool Eventless() const
+    {
+        return this->eventless;
+    }
+
     template<size_t Dim = D, typename std::enable_if<1 == Dim, int>::type = 0>
     size_t Length() const
     {
@@ -131,23 +183,23 @@ public:
         ONCLEANUP(wait, [this]{ if (CL_SUCCESS == this->err) this->Wait(); });
         return this->Map(queue, flags, {});
     }
-    CLMemMap<T> Map(cl_command_queue queue, int32_t flags, const std::vector<cl_event>& waits)
+    CLMemMap<T> Map(cl_command_queue queue, int32_t flags, const CLWaits& waits)
     {
-        return this->MapBytes(queue, flags, 0, this->depth * this->slice, {});
+        return this->MapBytes(queue, flags, 0, this->depth * this->slice, waits);
     }
     CLMemMap<T> Map(cl_command_queue queue, int32_t flags, size_t offset, size_t length)
     {
         ONCLEANUP(wait, [this]{ if (CL_SUCCESS == this->err) this->Wait(); });
         return this->Map(queue, flags, offset, length, {});
     }
-    CLMemMap<T> Map(cl_command_queue queue, int32_t flags, size_t offset, size_t length, const std::vector<cl_event>& waits)
+    CLMemMap<T> Map(cl_command_queue queue, int32_t flags, size_t offset, size_t length, const CLWaits& waits)
     {
         return this->MapBytes(queue, flags, offset * sizeof(T), length * sizeof(T), waits);
     }
 
     // General copy
     bool Copy(cl_command_queue queue, const CLBuffer& src, size_t srcX, size_t srcY, size_t srcZ, size_t width, size_t height, size_t depth,
-              size_t dstX, size_t dstY, size_t dstZ, const std::vector<cl_event>& waits)
+              size_t dstX, size_t dstY, size_t dstZ, const CLWaits& waits)
     {
         if (srcX + width  > src.width    ||
             srcY + height > src.height   ||
@@ -160,29 +212,29 @@ public:
             return false;
         }
 
-        std::vector<cl_event> events;
-        for (auto& e : waits)
-        {
-            if (e)
-            {
-                events.push_back(e);
-            }
-        }
+        CLWaitList events(waits);
+
+        src.Depends(false, events);
+        this->Depends(true, events);
 
         size_t srcorg[3] = { srcX  * sizeof(T), srcY,   srcZ };
         size_t dstorg[3] = { dstX  * sizeof(T), dstY,   dstZ };
         size_t region[3] = { width * sizeof(T), height, depth };
 
+        CLProbe probe(queue, CLOp::Copy, region[0] * region[1] * region[2]);
+
         cl_event event;
         this->err = clEnqueueCopyBufferRect(queue, src.mem, this->mem, srcorg, dstorg, region, src.pitch, src.slice,
-                                            this->pitch, this->slice, (cl_uint)events.size(), events.size() ? events.data() : nullptr, &event);
+                                            this->pitch, this->slice, events.Size(), events.Data(), this->Slot(event, src.Tracked() || probe.Wants()));
         if (CL_SUCCESS != this->err)
         {
             return false;
         }
 
-        this->evt = CLEvent(event);
-        clReleaseEvent(event);
+        probe.Done(event);
+        src.Record(false, event);
+        this->Record(true, event);
+        this->Retire(queue, event);
 
         return true;
     }
@@ -195,7 +247,7 @@ public:
         return this->Copy(queue, src, {});
     }
     template<size_t Dim = D, typename std::enable_if<1 == Dim, int>::type = 0>
-    bool Copy(cl_command_queue queue, const CLBuffer<T, 1>& src, const std::vector<cl_event>& waits)
+    bool Copy(cl_command_queue queue, const CLBuffer<T, 1>& src, const CLWaits& waits)
     {
         auto length = this->Length() < src.Length() ? this->Length() : src.Length();
         return this->Copy(queue, src, 0, length, 0, waits);
@@ -207,7 +259,7 @@ public:
         return this->Copy(queue, src, srcoff, length, dstoff, {});
     }
     template<size_t Dim = D, typename std::enable_if<1 == Dim, int>::type = 0>
-    bool Copy(cl_command_queue queue, const CLBuffer<T, 1>& src, size_t srcoff, size_t length, size_t dstoff, const std::vector<cl_event>& waits)
+    bool Copy(cl_command_queue queue, const CLBuffer<T, 1>& src, size_t srcoff, size_t length, size_t dstoff, const CLWaits& waits)
     {
         return this->Copy(queue, src, srcoff, 0, 0, length, 1, 1, dstoff, 0, 0, waits);
     }
@@ -220,7 +272,7 @@ public:
         return this->Copy(queue, src, {});
     }
     template<size_t Dim = D, typename std::enable_if<2 == Dim, int>::type = 0>
-    bool Copy(cl_command_queue queue, const CLBuffer<T, 2>& src, const std::vector<cl_event>& waits)
+    bool Copy(cl_command_queue queue, const CLBuffer<T, 2>& src, const CLWaits& waits)
     {
         auto wdith  = this->width  < src.width  ? this->width  : src.width;
         auto height = this->height < src.height ? this->height : src.height;
@@ -234,7 +286,7 @@ public:
     }
     template<size_t Dim = D, typename std::enable_if<2 == Dim, int>::type = 0>
     bool Copy(cl_command_queue queue, const CLBuffer<T, 2>& src, size_t srcX, size_t srcY, size_t width, size_t height,
-              size_t dstX, size_t dstY, const std::vector<cl_event>& waits)
+              size_t dstX, size_t dstY, const CLWaits& waits)
     {
         return this->Copy(queue, src, srcX, srcY, 0, width, height, 1, dstX, dstY, 0, waits);
     }
@@ -247,7 +299,7 @@ public:
         return this->Copy(queue, src, {});
     }
     template<size_t Dim = D, typename std::enable_if<3 == Dim, int>::type = 0>
-    bool Copy(cl_command_queue queue, const CLBuffer<T, 3>& src, const std::vector<cl_event>& waits)
+    bool Copy(cl_command_queue queue, const CLBuffer<T, 3>& src, const CLWaits& waits)
     {
         auto width  = this->width  < src.width  ? this->width  : src.width;
         auto height = this->height < src.height ? this->height : src.height;
@@ -270,7 +322,7 @@ public:
         return this->Copy(queue, src, {});
     }
     template<size_t Ds, size_t Dim = D, typename std::enable_if<1 == Dim, int>::type = 0>
-    bool Copy(cl_command_queue queue, const CLBuffer<T, Ds>& src, const std::vector<cl_event>& waits)
+    bool Copy(cl_command_queue queue, const CLBuffer<T, Ds>& src, const CLWaits& waits)
     {
         if (this->Length() != src.width * src.height * src.depth)
         {
@@ -278,14 +330,10 @@ public:
             return false;
         }
 
-        std::vector<cl_event> events;
-        for (auto& e : waits)
-        {
-            if (e)
-            {
-                events.push_back(e);
-            }
-        }
+        CLWaitList events(waits);
+
+        src.Depends(false, events);
+        this->Depends(true, events);
 
         size_t srcorg[3] = { 0, 0, 0 };
         size_t dstorg[3] = { 0, 0, 0 };
@@ -294,16 +342,20 @@ public:
         size_t pitch = region[0];
         size_t slice = src.height * pitch;
 
+        CLProbe probe(queue, CLOp::Copy, region[0] * region[1] * region[2]);
+
         cl_event event;
         this->err = clEnqueueCopyBufferRect(queue, src, this->mem, srcorg, dstorg, region, src.pitch, src.slice, pitch, slice,
-                                            (cl_uint)events.size(), events.size() ? events.data() : nullptr, &event);
+                                            events.Size(), events.Data(), this->Slot(event, src.Tracked() || probe.Wants()));
         if (CL_SUCCESS != this->err)
         {
             return false;
         }
 
-        this->evt = CLEvent(event);
-        clReleaseEvent(event);
+        probe.Done(event);
+        src.Record(false, event);
+        this->Record(true, event);
+        this->Retire(queue, event);
 
         return true;
     }
@@ -316,7 +368,7 @@ public:
         return this->Copy(queue, src, {});
     }
     template<size_t Dim = D, typename std::enable_if<2 == Dim || 3 == Dim, int>::type = 0>
-    bool Copy(cl_command_queue queue, const CLBuffer<T, 1>& src, const std::vector<cl_event>& waits)
+    bool Copy(cl_command_queue queue, const CLBuffer<T, 1>& src, const CLWaits& waits)
     {
         if (src.Length() != this->width * this->height * this->depth)
         {
@@ -324,14 +376,10 @@ public:
             return false;
         }
 
-        std::vector<cl_event> events;
-        for (auto& e : waits)
-        {
-            if (e)
-            {
-                events.push_back(e);
-            }
-        }
+        CLWaitList events(waits);
+
+        src.Depends(false, events);
+        this->Depends(true, events);
 
         size_t srcorg[3] = { 0, 0, 0 };
         size_t dstorg[3] = { 0, 0, 0 };
@@ -340,32 +388,31 @@ public:
         size_t pitch = region[0];
         size_t slice = this->height * pitch;
 
+        CLProbe probe(queue, CLOp::Copy, region[0] * region[1] * region[2]);
+
         cl_event event;
         this->err = clEnqueueCopyBufferRect(queue, src, this->mem, srcorg, dstorg, region, pitch, slice, this->pitch, this->slice,
-                                            (cl_uint)events.size(), events.size() ? events.data() : nullptr, &event);
+                                            events.Size(), events.Data(), this->Slot(event, src.Tracked() || probe.Wants()));
         if (CL_SUCCESS != this->err)
         {
             return false;
         }
 
-        this->evt = CLEvent(event);
-        clReleaseEvent(event);
+        probe.Done(event);
+        src.Record(false, event);
+        this->Record(true, event);
+        this->Retire(queue, event);
 
         return true;
     }
 
     // General read
     bool Read(cl_command_queue queue, size_t srcX, size_t srcY, size_t srcZ, size_t width, size_t height, size_t depth, T* dst,
-              size_t dstX, size_t dstY, size_t dstZ, size_t pitch, size_t slice, const std::vector<cl_event>& waits) const
+              size_t dstX, size_t dstY, size_t dstZ, size_t pitch, size_t slice, const CLWaits& waits) const
     {
-        std::vector<cl_event> events;
-        for (auto& e : waits)
-        {
-            if (e)
-            {
-                events.push_back(e);
-            }
-        }
+        CLWaitList events(waits);
+
+        this->Depends(false, events);
 
         size_t srcorg[3] = { srcX * sizeof(T), srcY, srcZ };
         size_t dstorg[3] = { dstX * sizeof(T), dstY, dstZ };
@@ -381,16 +428,19 @@ public:
             slice = height * pitch;
         }
 
+        CLProbe probe(queue, CLOp::Read, region[0] * region[1] * region[2]);
+
         cl_event event;
         this->err = clEnqueueReadBufferRect(queue, this->mem, CL_FALSE, srcorg, dstorg, region, this->pitch, this->slice, pitch, slice,
-                                            dst, (cl_uint)events.size(), events.size() ? events.data() : nullptr, &event);
+                                            dst, events.Size(), events.Data(), this->Slot(event, probe.Wants()));
         if (CL_SUCCESS != this->err)
         {
             return false;
         }
 
-        this->evt = CLEvent(event);
-        clReleaseEvent(event);
+        probe.Done(event);
+        this->Record(false, event);
+        this->Retire(queue, event);
 
         return true;
     }
@@ -403,7 +453,7 @@ public:
         return this->Read(queue, dst, {});
     }
     template<size_t Dim = D, typename std::enable_if<1 == Dim, int>::type = 0>
-    bool Read(cl_command_queue queue, T* dst, const std::vector<cl_event>& waits) const
+    bool Read(cl_command_queue queue, T* dst, const CLWaits& waits) const
     {
         return this->Read(queue, 0, this->Length(), dst, waits);
     }
@@ -414,7 +464,7 @@ public:
         return this->Read(queue, offset, length, dst, {});
     }
     template<size_t Dim = D, typename std::enable_if<1 == Dim, int>::type = 0>
-    bool Read(cl_command_queue queue, size_t offset, size_t length, T* dst, const std::vector<cl_event>& waits) const
+    bool Read(cl_command_queue queue, size_t offset, size_t length, T* dst, const CLWaits& waits) const
     {
         return this->Read(queue, offset, 0, 0, length, 1, 1, dst, 0, 0, 0, 0, 0, waits);
     }
@@ -427,9 +477,9 @@ public:
         return this->Read(queue, dst, {});
     }
     template<size_t Dim = D, typename std::enable_if<2 == Dim, int>::type = 0>
-    bool Read(cl_command_queue queue, T* dst, const std::vector<cl_event>& waits) const
+    bool Read(cl_command_queue queue, T* dst, const CLWaits& waits) const
     {
-        return this->Read(queue, 0, 0, this->width, this->height, dst, 0, 0, 0);
+        return this->Read(queue, 0, 0, this->width, this->height, dst, 0, 0, 0, waits);
     }
     template<size_t Dim = D, typename std::enable_if<2 == Dim, int>::type = 0>
     bool Read(cl_command_queue queue, size_t srcX, size_t srcY, size_t width, size_t height, T* dst,
@@ -440,7 +490,7 @@ public:
     }
     template<size_t Dim = D, typename std::enable_if<2 == Dim, int>::type = 0>
     bool Read(cl_command_queue queue, size_t srcX, size_t srcY, size_t width, size_t height, T* dst,
-              size_t dstX, size_t dstY, size_t pitch, const std::vector<cl_event>& waits) const
+              size_t dstX, size_t dstY, size_t pitch, const CLWaits& waits) const
     {
         return this->Read(queue, srcX, srcY, 0, width, height, 1, dst, dstX, dstY, 0, pitch, 0, waits);
     }
@@ -453,13 +503,13 @@ public:
         return this->Read(queue, dst, {});
     }
     template<size_t Dim = D, typename std::enable_if<3 == Dim, int>::type = 0>
-    bool Read(cl_command_queue queue, T* dst, const std::vector<cl_event>& waits) const
+    bool Read(cl_command_queue queue, T* dst, const CLWaits& waits) const
     {
         return this->Read(queue, 0, 0, 0, this->width, this->height, this->depth, dst, 0, 0, 0, 0, 0, waits);
     }
     template<size_t Dim = D, typename std::enable_if<3 == Dim, int>::type = 0>
     bool Read(cl_command_queue queue, size_t srcX, size_t srcY, size_t srcZ, size_t width, size_t height, size_t depth, T* dst,
-              size_t dstX, size_t dstY, size_t dstZ, size_t pitch, size_t slice, const std::vector<cl_event>& waits) const
+              size_t dstX, size_t dstY, size_t dstZ, size_t pitch, size_t slice, const CLWaits& waits) const
     {
         ONCLEANUP(wait, [this]{ if (CL_SUCCESS == this->err) this->Wait(); });
         return this->Read(queue, srcX, srcY, srcZ, width, height, depth, dst, dstX, dstY, dstZ, pitch, slice, {});
@@ -467,16 +517,11 @@ public:
 
     // General write
     bool Write(cl_command_queue queue, size_t dstX, size_t dstY, size_t dstZ, size_t width, size_t height, size_t depth, const T* src,
-               size_t srcX, size_t srcY, size_t srcZ, size_t pitch, size_t slice, const std::vector<cl_event>& waits)
+               size_t srcX, size_t srcY, size_t srcZ, size_t pitch, size_t slice, const CLWaits& waits)
     {
-        std::vector<cl_event> events;
-        for (auto& e : waits)
-        {
-            if (e)
-            {
-                events.push_back(e);
-            }
-        }
+        CLWaitList events(waits);
+
+        this->Depends(true, events);
 
         size_t srcorg[3] = { srcX * sizeof(T), srcY, srcZ };
         size_t dstorg[3] = { dstX * sizeof(T), dstY, dstZ };
@@ -492,16 +537,19 @@ public:
             slice = height * pitch;
         }
 
+        CLProbe probe(queue, CLOp::Write, region[0] * region[1] * region[2]);
+
         cl_event event;
         this->err = clEnqueueWriteBufferRect(queue, this->mem, CL_FALSE, dstorg, srcorg, region, this->pitch, this->slice, pitch, slice,
-                                             src, (cl_uint)events.size(), events.size() ? events.data() : nullptr, &event);
+                                             src, events.Size(), events.Data(), this->Slot(event, probe.Wants()));
         if (CL_SUCCESS != this->err)
         {
             return false;
         }
 
-        this->evt = CLEvent(event);
-        clReleaseEvent(event);
+        probe.Done(event);
+        this->Record(true, event);
+        this->Retire(queue, event);
 
         return true;
     }
@@ -515,7 +563,7 @@ public:
         return this->Write(queue, src, {});
     }
     template<size_t Dim = D, typename std::enable_if<1 == Dim, int>::type = 0>
-    bool Write(cl_command_queue queue, const T* src, const std::vector<cl_event>& waits)
+    bool Write(cl_command_queue queue, const T* src, const CLWaits& waits)
     {
         return this->Write(queue, 0, this->Length(), src, waits);
     }
@@ -526,7 +574,7 @@ public:
         return this->Write(queue, offset, length, src, {});
     }
     template<size_t Dim = D, typename std::enable_if<1 == Dim, int>::type = 0>
-    bool Write(cl_command_queue queue, size_t offset, size_t length, const T* src, const std::vector<cl_event>& waits)
+    bool Write(cl_command_queue queue, size_t offset, size_t length, const T* src, const CLWaits& waits)
     {
         return this->Write(queue, offset, 0, 0, length, 1, 1, src, 0, 0, 0, 0, 0, waits);
     }
@@ -539,7 +587,7 @@ public:
         return this->Write(queue, src, {});
     }
     template<size_t Dim = D, typename std::enable_if<2 == Dim, int>::type = 0>
-    bool Write(cl_command_queue queue, const T* src, const std::vector<cl_event>& waits)
+    bool Write(cl_command_queue queue, const T* src, const CLWaits& waits)
     {
         return this->Write(queue, 0, 0, this->width, this->height, src, 0, 0, 0, waits);
     }
@@ -552,7 +600,7 @@ public:
     }
     template<size_t Dim = D, typename std::enable_if<2 == Dim, int>::type = 0>
     bool Write(cl_command_queue queue, size_t dstX, size_t dstY, size_t width, size_t height, const T* src,
-               size_t srcX, size_t srcY, size_t pitch, const std::vector<cl_event>& waits)
+               size_t srcX, size_t srcY, size_t pitch, const CLWaits& waits)
     {
         return this->Write(queue, dstX, dstY, 0, width, height, 1, src, srcX, srcY, 0, pitch, 0, waits);
     }
@@ -565,9 +613,9 @@ public:
         return this->Write(queue, src, {});
     }
     template<size_t Dim = D, typename std::enable_if<3 == Dim, int>::type = 0>
-    bool Write(cl_command_queue queue, const T* src, const std::vector<cl_event>& waits)
+    bool Write(cl_command_queue queue, const T* src, const CLWaits& waits)
     {
-        return this->Write(queue, 0, 0, 0, this->width, this->height, this->depth, src, 0, 0, 0, 0, 0);
+        return this->Write(queue, 0, 0, 0, this->width, this->height, this->depth, src, 0, 0, 0, 0, 0, waits);
     }
     template<size_t Dim = D, typename std::enable_if<3 == Dim, int>::type = 0>
     bool Write(cl_command_queue queue, size_t dstX, size_t dstY, size_t dstZ, size_t width, size_t height, size_t depth, const T* src,
@@ -713,7 +761,7 @@ public:
     }
 
 protected:
-    CLMemMap<T> MapBytes(cl_command_queue queue, int32_t flags, size_t offsetInBytes, size_t sizeInBytes, const std::vector<cl_event>& waits)
+    CLMemMap<T> MapBytes(cl_command_queue queue, int32_t flags, size_t offsetInBytes, size_t sizeInBytes, const CLWaits& waits)
     {
         if (!this->mem)
         {
@@ -730,27 +778,76 @@ protected:
             mflags |= CL_MAP_WRITE;
         }
 
-        std::vector<cl_event> events;
-        for (auto& e : waits)
-        {
-            if (e)
-            {
-                events.push_back(e);
-            }
-        }
+        CLWaitList events(waits);
+
+        this->Depends(!!(CLFlags::WO & flags), events);
+
+        CLProbe probe(queue, CLOp::Map, sizeInBytes);
 
         cl_event event;
-        auto map = clEnqueueMapBuffer(queue, this->mem, CL_FALSE, mflags, offsetInBytes, sizeInBytes, (cl_uint)events.size(), events.size() ? events.data() : nullptr, &event, &this->err);
+        auto map = clEnqueueMapBuffer(queue, this->mem, CL_FALSE, mflags, offsetInBytes, sizeInBytes, events.Size(), events.Data(), &event, &this->err);
 
         if (CL_SUCCESS != this->err)
         {
             return CLMemMap<T>();
         }
 
+        probe.Done(event);
         this->evt = CLEvent(event);
+        this->Record(!!(CLFlags::WO & flags), event);
         clReleaseEvent(event);
 
-        return CLMemMap<T>(this->mem, queue, event, map);
+        return CLMemMap<T>(this->mem, queue, event, map, this->hzd, !!(CLFlags::WO & flags));
+    }
+
+    void Depends(bool write, CLWaitList& events) const
+    {
+        if (this->hzd)
+        {
+            this->hzd->Depends(write, events);
+        }
+    }
+    void Record(bool write, cl_event event) const
+    {
+        if (this->hzd)
+        {
+            this->hzd->Record(write, event);
+        }
+    }
+
+    // Where the next command returns its event, nullptr when nobody is going to wait on it.
+    cl_event* Slot(cl_event& event, bool tracked = false) const
+    {
+        event = nullptr;
+        return !this->eventless || this->hzd || tracked ? &event : nullptr;
+    }
+    // Takes over the event returned into Slot(), or remembers 'queue' for Wait() if there is none.
+    void Retire(cl_command_queue queue, cl_event event) const
+    {
+        if (event)
+        {
+            this->evt = CLEvent(event);
+            clReleaseEvent(event);
+
+            if (this->last)
+            {
+                this->last = CLQueue();
+            }
+        }
+        else
+        {
+            this->evt = CLEvent();
+
+            if (queue != this->last)
+            {
+                this->last = CLQueue(queue);
+            }
+        }
+    }
+
+    cl_int Finish() const
+    {
+        return this->last ? clFinish(this->last) : CL_SUCCESS;
     }
 
 protected:
@@ -763,6 +860,10 @@ protected:
 
     mutable cl_int  err;
     mutable CLEvent evt;
+    mutable CLQueue last;
+
+    std::shared_ptr<CLHazard> hzd;
+    bool eventless;
 };
 
 template<typename T>
@@ -3,48 +3,69 @@
 #ifndef ONCLEANUP
 
 #include <functional>
+#include <utility>
 #include <vector>
 
+// Runs the cleanup function given at construction when leaving the scope. The function is held by value,
+// so the common case allocates nothing; only functions added later go into a list.
+template<typename F>
 class _cleanup
 {
 public:
-    _cleanup(const std::function<void()>& func)
+    _cleanup(F func) : func(std::move(func)), active(true)
     {
-        if (func)
-        {
-            this->func.push_back(func);
-        }
     }
+    _cleanup(_cleanup&& other) : func(std::move(other.func)), more(std::move(other.more)), active(other.active)
+    {
+        other.active = false;
+        other.more.clear();
+    }
+    _cleanup(const _cleanup&) = delete;
    ~_cleanup()
     {
-        for (auto itr = this->func.rbegin(); itr != this->func.rend(); itr++)
+        for (auto itr = this->more.rbegin(); itr != this->more.rend(); itr++)
         {
             (*itr)();
         }
+
+        if (this->active)
+        {
+            this->func();
+        }
     }
 
     void add(const std::function<void()>& func)
     {
         if (func)
         {
-            this->func.push_back(func);
+            this->more.push_back(func);
         }
     }
 
     void reset(const std::function<void()>& func)
     {
-        this->func.clear();
+        this->active = false;
+        this->more.clear();
 
         if (func)
         {
-            this->func.push_back(func);
+            this->more.push_back(func);
         }
     }
 
 private:
-    std::vector<std::function<void()>> func;
+    F func;
+    std::vector<std::function<void()>> more;
+    bool active;
 };
-#define ONCLEANUP(X, F) _cleanup _cleanup_##X(F)
+
+template<typename F>
+_cleanup<F> _makecleanup(F func)
+{
+    return _cleanup<F>(std::move(func));
+}
+
+#define ONCLEANUP(X, F) auto _cleanup_##X = _makecleanup(F)
 #define ADDCLEANUP(X, F) _cleanup_##X.add(F)
 #define RESETCLEANUP(X, F) _cleanup_##X.reset(F)
 
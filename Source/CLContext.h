@@ -81,6 +81,36 @@ public:
 
         return CLDevice(ids[0]);
     }
+    std::vector<CLDevice> Devices() const
+    {
+        std::vector<CLDevice> devices;
+        if (!this->context)
+        {
+            return devices;
+        }
+
+        cl_uint num;
+        cl_int error = clGetContextInfo(this->context, CL_CONTEXT_NUM_DEVICES, sizeof(num), &num, nullptr);
+        if (CL_SUCCESS != error || !num)
+        {
+            return devices;
+        }
+
+        std::vector<cl_device_id> ids(num);
+        error = clGetContextInfo(this->context, CL_CONTEXT_DEVICES, ids.size() * sizeof(ids[0]), &ids[0], nullptr);
+        if (CL_SUCCESS != error)
+        {
+            return devices;
+        }
+
+        devices.reserve(num);
+        for (auto id : ids)
+        {
+            devices.push_back(CLDevice(id));
+        }
+
+        return devices;
+    }
 
     operator cl_context() const
     {
@@ -98,6 +128,17 @@ public:
         ONCLEANUP(context, [=]{ if (context) clReleaseContext(context); });
         return CLContext(context);
     }
+    static CLContext Create(const std::vector<cl_device_id>& devices)
+    {
+        if (devices.empty())
+        {
+            return CLContext();
+        }
+
+        cl_context context = clCreateContext(nullptr, (cl_uint)devices.size(), devices.data(), nullptr, nullptr, nullptr);
+        ONCLEANUP(context, [=]{ if (context) clReleaseContext(context); });
+        return CLContext(context);
+    }
     static CLContext CreateDefault()
     {
         CLDevice selected(0);
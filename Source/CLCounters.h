@@ -0,0 +1,192 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Kind of an enqueued command.
+class CLOp
+{
+public:
+    enum Type
+    {
+        Read,
+        Write,
+        Copy,
+        Map,
+        Unmap,
+        Kernel,
+        Marker,
+        Barrier,
+        Count
+    };
+
+    static const char* Name(Type type)
+    {
+        static const char* names[Count] = { "Read", "Write", "Copy", "Map", "Unmap", "Kernel", "Marker", "Barrier" };
+        return type < Count ? names[type] : "Unknown";
+    }
+};
+
+// Counter values at one point in time. Subtract an earlier snapshot to get the activity in between.
+struct CLCounterSnapshot
+{
+    CLCounterSnapshot() : Waits(0), Blocked(0), Builds(0), BuildTime(0)
+    {
+        for (size_t i = 0; i < CLOp::Count; i++)
+        {
+            this->Enqueues[i] = 0;
+            this->Bytes[i] = 0;
+        }
+    }
+
+    uint64_t Enqueues[CLOp::Count];
+    uint64_t Bytes[CLOp::Count];            // Read, written, copied and mapped bytes
+    uint64_t Waits;                         // Wait() calls, including those of synchronous overloads
+    uint64_t Blocked;                       // Nanoseconds spent in Wait()
+    uint64_t Builds;                        // Programs built from source or binaries
+    uint64_t BuildTime;                     // Nanoseconds spent building
+    std::map<std::string, uint64_t> Launches;
+
+    CLCounterSnapshot operator-(const CLCounterSnapshot& earlier) const
+    {
+        CLCounterSnapshot delta(*this);
+        for (size_t i = 0; i < CLOp::Count; i++)
+        {
+            delta.Enqueues[i] -= earlier.Enqueues[i];
+            delta.Bytes[i]    -= earlier.Bytes[i];
+        }
+
+        delta.Waits     -= earlier.Waits;
+        delta.Blocked   -= earlier.Blocked;
+        delta.Builds    -= earlier.Builds;
+        delta.BuildTime -= earlier.BuildTime;
+
+        for (auto& launch : earlier.Launches)
+        {
+            auto itr = delta.Launches.find(launch.first);
+            if (itr != delta.Launches.end())
+            {
+                itr->second -= launch.second;
+            }
+        }
+        return delta;
+    }
+};
+
+// Process-wide counters cheap enough to stay enabled in production. The wrappers update them with relaxed
+// atomics, so a snapshot taken while other threads enqueue is not an exact cut across all counters.
+class CLCounters
+{
+public:
+    static CLCounters& Global()
+    {
+        static CLCounters counters;
+        return counters;
+    }
+
+    void Enqueued(CLOp::Type type, size_t bytes)
+    {
+        this->enqueues[type].fetch_add(1, std::memory_order_relaxed);
+        if (bytes)
+        {
+            this->bytes[type].fetch_add(bytes, std::memory_order_relaxed);
+        }
+    }
+
+    void Waited(uint64_t ns)
+    {
+        this->waits.fetch_add(1, std::memory_order_relaxed);
+        this->blocked.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    void Built(uint64_t ns)
+    {
+        this->builds.fetch_add(1, std::memory_order_relaxed);
+        this->buildTime.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    // Launch counter of kernel 'name'. Looked up once per kernel object, the reference stays valid.
+    std::atomic<uint64_t>& Launches(const std::string& name)
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+
+        auto& counter = this->launches[name];
+        if (!counter)
+        {
+            counter.reset(new std::atomic<uint64_t>(0));
+        }
+        return *counter;
+    }
+
+    CLCounterSnapshot Snapshot() const
+    {
+        CLCounterSnapshot snapshot;
+        for (size_t i = 0; i < CLOp::Count; i++)
+        {
+            snapshot.Enqueues[i] = this->enqueues[i].load(std::memory_order_relaxed);
+            snapshot.Bytes[i]    = this->bytes[i].load(std::memory_order_relaxed);
+        }
+
+        snapshot.Waits     = this->waits.load(std::memory_order_relaxed);
+        snapshot.Blocked   = this->blocked.load(std::memory_order_relaxed);
+        snapshot.Builds    = this->builds.load(std::memory_order_relaxed);
+        snapshot.BuildTime = this->buildTime.load(std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> guard(this->lock);
+        for (auto& launch : this->launches)
+        {
+            snapshot.Launches[launch.first] = launch.second->load(std::memory_order_relaxed);
+        }
+
+        return snapshot;
+    }
+
+    static uint64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+protected:
+    CLCounters() : waits(0), blocked(0), builds(0), buildTime(0)
+    {
+        for (size_t i = 0; i < CLOp::Count; i++)
+        {
+            this->enqueues[i] = 0;
+            this->bytes[i] = 0;
+        }
+    }
+    CLCounters(const CLCounters&) = delete;
+    CLCounters& operator=(const CLCounters&) = delete;
+
+protected:
+    std::atomic<uint64_t> enqueues[CLOp::Count];
+    std::atomic<uint64_t> bytes[CLOp::Count];
+    std::atomic<uint64_t> waits;
+    std::atomic<uint64_t> blocked;
+    std::atomic<uint64_t> builds;
+    std::atomic<uint64_t> buildTime;
+
+    mutable std::mutex lock;
+    std::map<std::string, std::unique_ptr<std::atomic<uint64_t>>> launches;
+};
+
+// Counts one blocking wait and the time until the end of the scope.
+class CLWaitScope
+{
+public:
+    CLWaitScope() : start(CLCounters::Now())
+    {
+    }
+   ~CLWaitScope()
+    {
+        CLCounters::Global().Waited(CLCounters::Now() - this->start);
+    }
+
+protected:
+    uint64_t start;
+};
\ No newline at end of file
@@ -16,6 +16,13 @@ public:
         return type;
     }
 
+    cl_platform_id Platform() const
+    {
+        cl_platform_id platform;
+        this->Info(CL_DEVICE_PLATFORM, platform);
+        return platform;
+    }
+
     std::string Name() const
     {
         std::string name;
@@ -52,6 +59,15 @@ public:
         this->Info(CL_DEVICE_EXTENSIONS, extensions);
         return extensions;
     }
+#if CL_TARGET_OPENCL_VERSION >= 210
+    // Intermediate languages accepted by CLProgram::CreateFromIL(), e.g. "SPIR-V_1.2", empty if none.
+    std::string IL() const
+    {
+        std::string il;
+        this->Info(CL_DEVICE_IL_VERSION, il);
+        return il;
+    }
+#endif
 
     bool ImageSupport() const
     {
@@ -66,6 +82,18 @@ public:
         return unified ? true : false;
     }
 
+    size_t MaxComputeUnits() const
+    {
+        cl_uint units;
+        this->Info(CL_DEVICE_MAX_COMPUTE_UNITS, units);
+        return (size_t)units;
+    }
+    size_t MaxClockFrequency() const
+    {
+        cl_uint mhz;
+        this->Info(CL_DEVICE_MAX_CLOCK_FREQUENCY, mhz);
+        return (size_t)mhz;
+    }
     size_t MaxWorkGroupSize() const
     {
         size_t size;
@@ -89,6 +117,22 @@ public:
         return (size_t)size;
     }
 
+    // Vector width the compiler prefers for scalar 'type', e.g. "float" or "uchar", which is where the device
+    // is fastest. Zero if the type is not supported, like double without cl_khr_fp64.
+    size_t PreferredVectorWidth(const std::string& type) const
+    {
+        cl_uint width;
+        this->Info(VectorWidth(type, true), width);
+        return (size_t)width;
+    }
+    // Widest vector of 'type' the hardware handles in one instruction.
+    size_t NativeVectorWidth(const std::string& type) const
+    {
+        cl_uint width;
+        this->Info(VectorWidth(type, false), width);
+        return (size_t)width;
+    }
+
     operator cl_device_id() const
     {
         return this->id;
@@ -100,6 +144,21 @@ public:
     }
 
 protected:
+    static cl_device_info VectorWidth(const std::string& type, bool preferred)
+    {
+        auto name = 'u' == type[0] && type.size() > 1 ? type.substr(1) : type;
+
+        if ("char"   == name) return preferred ? CL_DEVICE_PREFERRED_VECTOR_WIDTH_CHAR   : CL_DEVICE_NATIVE_VECTOR_WIDTH_CHAR;
+        if ("short"  == name) return preferred ? CL_DEVICE_PREFERRED_VECTOR_WIDTH_SHORT  : CL_DEVICE_NATIVE_VECTOR_WIDTH_SHORT;
+        if ("int"    == name) return preferred ? CL_DEVICE_PREFERRED_VECTOR_WIDTH_INT    : CL_DEVICE_NATIVE_VECTOR_WIDTH_INT;
+        if ("long"   == name) return preferred ? CL_DEVICE_PREFERRED_VECTOR_WIDTH_LONG   : CL_DEVICE_NATIVE_VECTOR_WIDTH_LONG;
+        if ("float"  == name) return preferred ? CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT  : CL_DEVICE_NATIVE_VECTOR_WIDTH_FLOAT;
+        if ("double" == name) return preferred ? CL_DEVICE_PREFERRED_VECTOR_WIDTH_DOUBLE : CL_DEVICE_NATIVE_VECTOR_WIDTH_DOUBLE;
+        if ("half"   == name) return preferred ? CL_DEVICE_PREFERRED_VECTOR_WIDTH_HALF   : CL_DEVICE_NATIVE_VECTOR_WIDTH_HALF;
+
+        throw std::runtime_error("Unknown vector element type " + type);
+    }
+
     void Info(cl_device_info param, std::string& info) const
     {
         info.clear();
@@ -1,10 +1,151 @@
 #pragma once
 
 #include <CL/cl.h>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <utility>
 
+// Device timestamps in nanoseconds, all zero if the queue was not created with profiling enabled.
+struct CLEventProfile
+{
+    CLEventProfile() : Queued(0), Submit(0), Start(0), End(0), Complete(0) {}
+
+    cl_ulong Queued;
+    cl_ulong Submit;
+    cl_ulong Start;
+    cl_ulong End;
+    cl_ulong Complete;
+
+    cl_ulong Latency() const    // Queued to end
+    {
+        return this->End > this->Queued ? this->End - this->Queued : 0;
+    }
+    cl_ulong Duration() const   // Start to end
+    {
+        return this->End > this->Start ? this->End - this->Start : 0;
+    }
+};
+
+// How to wait for a command. Blocking parks the thread in clWaitForEvents, which costs a wake-up that can
+// be longer than a small kernel. Spin polls the status for up to 'spin' first. Adaptive also spins, but
+// only for about twice the completion time learnt from recent waits, and blocks straight away when those
+// take longer than 'spin'. With a timeout Wait() returns the positive execution status instead of
+// CL_SUCCESS if the command did not complete in time.
+class CLWaitPolicy
+{
+public:
+    enum Mode
+    {
+        Block,
+        Spin,
+        Adaptive
+    };
+
+    CLWaitPolicy(Mode mode = Block, std::chrono::microseconds spin = std::chrono::microseconds(0),
+                 std::chrono::microseconds timeout = std::chrono::microseconds::max())
+        : mode(mode), spin(spin), timeout(timeout), recent(std::make_shared<std::atomic<long long>>(0))
+    {
+    }
+
+    static CLWaitPolicy Blocking(std::chrono::microseconds timeout = std::chrono::microseconds::max())
+    {
+        return CLWaitPolicy(Block, std::chrono::microseconds(0), timeout);
+    }
+    static CLWaitPolicy Spinning(std::chrono::microseconds spin, std::chrono::microseconds timeout = std::chrono::microseconds::max())
+    {
+        return CLWaitPolicy(Spin, spin, timeout);
+    }
+    static CLWaitPolicy Adapting(std::chrono::microseconds spin, std::chrono::microseconds timeout = std::chrono::microseconds::max())
+    {
+        return CLWaitPolicy(Adaptive, spin, timeout);
+    }
+
+    // Policy of the synchronous overloads and Wait() without arguments. Not synchronized, set it up before
+    // commands are issued. Its timeout is ignored since synchronous calls have to complete.
+    static const CLWaitPolicy& Default()
+    {
+        return Global();
+    }
+    static void Default(const CLWaitPolicy& policy)
+    {
+        Global() = CLWaitPolicy(policy.mode, policy.spin);
+        Global().recent = policy.recent;
+    }
+
+    Mode Type() const
+    {
+        return this->mode;
+    }
+
+    bool Timed() const
+    {
+        return this->timeout != std::chrono::microseconds::max();
+    }
+
+    std::chrono::microseconds Timeout() const
+    {
+        return this->timeout;
+    }
+
+    // How long to poll before blocking.
+    std::chrono::nanoseconds Budget() const
+    {
+        switch (this->mode)
+        {
+            case Spin:
+            {
+                return this->spin;
+            }
+
+            case Adaptive:
+            {
+                auto recent = std::chrono::nanoseconds(this->recent->load(std::memory_order_relaxed));
+                if (recent.count() <= 0)
+                {
+                    return this->spin;
+                }
+                return recent > this->spin ? std::chrono::nanoseconds(0) : (2 * recent < this->spin ? 2 * recent : this->spin);
+            }
+
+            default:
+            {
+                return std::chrono::nanoseconds(0);
+            }
+        }
+    }
+
+    // Feeds the completion time of a finished wait into the adaptive estimate.
+    void Learn(std::chrono::nanoseconds elapsed) const
+    {
+        if (Adaptive != this->mode)
+        {
+            return;
+        }
+
+        auto recent = this->recent->load(std::memory_order_relaxed);
+        this->recent->store(recent > 0 ? (recent * 7 + elapsed.count()) / 8 : elapsed.count(), std::memory_order_relaxed);
+    }
+
+protected:
+    static CLWaitPolicy& Global()
+    {
+        static CLWaitPolicy policy;
+        return policy;
+    }
+
+protected:
+    Mode mode;
+    std::chrono::microseconds spin;
+    std::chrono::microseconds timeout;
+    std::shared_ptr<std::atomic<long long>> recent;
+};
+
 class CLEvent
 {
 public:
@@ -59,14 +200,141 @@ public:
 
     cl_int Wait() const
     {
-        return this->event ? clWaitForEvents(1, &this->event) : 0;
+        if (CLWaitPolicy::Block == CLWaitPolicy::Default().Type())
+        {
+            return this->event ? clWaitForEvents(1, &this->event) : 0;
+        }
+        return this->Wait(CLWaitPolicy::Default());
+    }
+    // Returns CL_SUCCESS once complete, a negative error, or the positive execution status on timeout.
+    cl_int Wait(const CLWaitPolicy& policy) const
+    {
+        if (!this->event)
+        {
+            return CL_SUCCESS;
+        }
+
+        typedef std::chrono::steady_clock clock;
+
+        auto start  = clock::now();
+        auto budget = policy.Budget();
+        auto limit  = policy.Timed() ? start + policy.Timeout() : clock::time_point::max();
+
+        auto status = this->Status();
+        while (status > CL_COMPLETE && clock::now() - start < budget)
+        {
+            if (clock::now() >= limit)
+            {
+                return status;
+            }
+            status = this->Status();
+        }
+
+        if (status <= CL_COMPLETE)
+        {
+            policy.Learn(clock::now() - start);
+            return status;
+        }
+
+        if (!policy.Timed())
+        {
+            auto error = clWaitForEvents(1, &this->event);
+            policy.Learn(clock::now() - start);
+            return error;
+        }
+
+        struct Signal
+        {
+            Signal() : done(false), status(CL_COMPLETE) {}
+
+            std::mutex lock;
+            std::condition_variable cv;
+            bool   done;
+            cl_int status;
+        };
+
+        auto signal = std::make_shared<Signal>();
+        auto error  = this->OnComplete([signal](cl_int status)
+        {
+            std::lock_guard<std::mutex> guard(signal->lock);
+            signal->done = true;
+            signal->status = status;
+            signal->cv.notify_all();
+        });
+        if (CL_SUCCESS != error)
+        {
+            return error;
+        }
+
+        std::unique_lock<std::mutex> guard(signal->lock);
+        if (!signal->cv.wait_until(guard, limit, [&signal]{ return signal->done; }))
+        {
+            return this->Status();
+        }
+
+        policy.Learn(clock::now() - start);
+        return signal->status < 0 ? signal->status : CL_SUCCESS;
+    }
+
+    // Calls 'callback' from the OpenCL runtime's callback thread once the command completed or failed, with
+    // CL_COMPLETE or the negative error status. The callback must not block on OpenCL calls.
+    cl_int OnComplete(const std::function<void(cl_int)>& callback) const
+    {
+        if (!this->event)
+        {
+            return CL_INVALID_EVENT;
+        }
+
+        auto func = new std::function<void(cl_int)>(callback);
+        auto error = clSetEventCallback(this->event, CL_COMPLETE, Completed, func);
+        if (CL_SUCCESS != error)
+        {
+            delete func;
+        }
+
+        return error;
+    }
+
+    // Completes a user event with CL_COMPLETE or a negative error, which fails every command waiting on it.
+    cl_int Signal(cl_int status = CL_COMPLETE) const
+    {
+        return clSetUserEventStatus(this->event, status);
     }
 
     cl_int Status() const
     {
         cl_int status;
-        clGetEventInfo(this->event, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, nullptr);
-        return status;
+        cl_int error = clGetEventInfo(this->event, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, nullptr);
+        return CL_SUCCESS == error ? status : error;
+    }
+
+    CLEventProfile Profile() const
+    {
+        CLEventProfile profile;
+        if (!this->event)
+        {
+            return profile;
+        }
+
+        if (CL_SUCCESS != clGetEventProfilingInfo(this->event, CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &profile.Queued, nullptr) ||
+            CL_SUCCESS != clGetEventProfilingInfo(this->event, CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong), &profile.Submit, nullptr) ||
+            CL_SUCCESS != clGetEventProfilingInfo(this->event, CL_PROFILING_COMMAND_START,  sizeof(cl_ulong), &profile.Start,  nullptr) ||
+            CL_SUCCESS != clGetEventProfilingInfo(this->event, CL_PROFILING_COMMAND_END,    sizeof(cl_ulong), &profile.End,    nullptr))
+        {
+            return CLEventProfile();
+        }
+
+#if CL_TARGET_OPENCL_VERSION >= 200
+        // Complete covers child kernels enqueued on device, some drivers do not report it.
+        if (CL_SUCCESS != clGetEventProfilingInfo(this->event, CL_PROFILING_COMMAND_COMPLETE, sizeof(cl_ulong), &profile.Complete, nullptr))
+        {
+            profile.Complete = profile.End;
+        }
+#else
+        profile.Complete = profile.End;
+#endif
+
+        return profile;
     }
 
     operator cl_event() const
@@ -79,6 +347,38 @@ public:
         return !!this->event;
     }
 
+    // An event completed from the host with Signal(). Commands can be staged ahead of time gated on it, so
+    // only the signal is left on the critical path once the input arrives.
+    static CLEvent CreateUser(cl_context context, cl_int* error = nullptr)
+    {
+        cl_int status;
+        cl_event event = clCreateUserEvent(context, &status);
+        if (error)
+        {
+            *error = status;
+        }
+
+        if (CL_SUCCESS != status)
+        {
+            return CLEvent();
+        }
+
+        CLEvent user(event);
+        clReleaseEvent(event);
+        return user;
+    }
+
+protected:
+    static void CL_CALLBACK Completed(cl_event, cl_int status, void* data)
+    {
+        auto func = (std::function<void(cl_int)>*)data;
+        if (*func)
+        {
+            (*func)(status);
+        }
+        delete func;
+    }
+
 protected:
     cl_event event;
 };
\ No newline at end of file
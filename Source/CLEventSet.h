@@ -0,0 +1,182 @@
+#pragma once
+
+#include "CLEvent.h"
+#include "CLWaits.h"
+#include <condition_variable>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// A group of pending commands synchronized together. Anything convertible to cl_event can be added, which
+// covers CLBuffer, CLImage, CLKernel and CLMemMap. WaitAll() costs one clWaitForEvents for the whole set,
+// Merge() folds the set into a single marker event for fan-in points, and the set itself can be passed as
+// a wait list. All events of a set must belong to the same context.
+class CLEventSet
+{
+public:
+    static const size_t npos = (size_t)-1;
+
+    CLEventSet() : err(0)
+    {
+    }
+    CLEventSet(std::initializer_list<cl_event> events) : CLEventSet()
+    {
+        for (auto event : events)
+        {
+            this->Add(event);
+        }
+    }
+
+    // Objects without a pending command are ignored.
+    CLEventSet& Add(cl_event event)
+    {
+        if (event)
+        {
+            this->events.push_back(CLEvent(event));
+            this->handles.push_back(event);
+        }
+        return *this;
+    }
+
+    void Clear()
+    {
+        this->events.clear();
+        this->handles.clear();
+    }
+
+    // Blocks until every command of the set completed.
+    cl_int WaitAll() const
+    {
+        this->err = this->handles.empty() ? CL_SUCCESS : clWaitForEvents((cl_uint)this->handles.size(), this->handles.data());
+        return this->err;
+    }
+
+    // Blocks until one command of the set completed or failed and returns its index, npos on failure.
+    size_t WaitAny() const
+    {
+        this->err = CL_SUCCESS;
+        if (this->events.empty())
+        {
+            return npos;
+        }
+
+        auto index = this->Completed();
+        if (npos != index)
+        {
+            return index;
+        }
+
+        struct Signal
+        {
+            Signal() : index(npos) {}
+
+            std::mutex lock;
+            std::condition_variable cv;
+            size_t index;
+        };
+
+        auto signal = std::make_shared<Signal>();
+        for (size_t i = 0; i < this->events.size(); i++)
+        {
+            auto error = this->events[i].OnComplete([signal, i](cl_int)
+            {
+                std::lock_guard<std::mutex> guard(signal->lock);
+                if (npos == signal->index)
+                {
+                    signal->index = i;
+                    signal->cv.notify_all();
+                }
+            });
+
+            if (CL_SUCCESS != error)
+            {
+                this->err = error;
+                return npos;
+            }
+        }
+
+        std::unique_lock<std::mutex> guard(signal->lock);
+        signal->cv.wait(guard, [&signal]{ return npos != signal->index; });
+
+        index = signal->index;
+        guard.unlock();
+
+        auto status = this->events[index].Status();
+        if (status < 0)
+        {
+            this->err = status;
+        }
+        return index;
+    }
+
+    // Index of a command that already completed or failed without blocking, npos if all are pending.
+    size_t Completed() const
+    {
+        for (size_t i = 0; i < this->events.size(); i++)
+        {
+            auto status = this->events[i].Status();
+            if (status <= CL_COMPLETE)
+            {
+                if (status < 0)
+                {
+                    this->err = status;
+                }
+                return i;
+            }
+        }
+        return npos;
+    }
+
+    // One event on 'queue' which completes after the whole set. An empty set yields a marker after all
+    // commands previously enqueued on 'queue'.
+    CLEvent Merge(cl_command_queue queue) const
+    {
+        cl_event event;
+        this->err = clEnqueueMarkerWithWaitList(queue, (cl_uint)this->handles.size(), this->handles.empty() ? nullptr : this->handles.data(), &event);
+        if (CL_SUCCESS != this->err)
+        {
+            return CLEvent();
+        }
+
+        CLEvent merged(event);
+        clReleaseEvent(event);
+        return merged;
+    }
+
+    const CLEvent& operator[](size_t index) const
+    {
+        return this->events[index];
+    }
+
+    // Lets the set be passed wherever a wait list is expected.
+    operator const std::vector<cl_event>&() const
+    {
+        return this->handles;
+    }
+    operator CLWaits() const
+    {
+        return CLWaits(this->handles);
+    }
+
+    size_t Size() const
+    {
+        return this->events.size();
+    }
+
+    bool Empty() const
+    {
+        return this->events.empty();
+    }
+
+    cl_int Error() const
+    {
+        return this->err;
+    }
+
+protected:
+    std::vector<CLEvent>  events;
+    std::vector<cl_event> handles;
+
+    mutable cl_int err;
+};
\ No newline at end of file
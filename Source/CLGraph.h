@@ -0,0 +1,410 @@
+#pragma once
+
+#include "CLKernel.h"
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// A DAG of commands over memory objects. Dependencies are derived from the declared read and write sets
+// (read-after-write, write-after-read and write-after-write), reduced to the minimal set, and turned into
+// event wait lists when the graph is executed. Independent chains are spread over the given queues.
+class CLGraph
+{
+public:
+    // Enqueues the node's work on 'queue' after 'waits' and returns the command's event in 'event'.
+    typedef std::function<cl_int(cl_command_queue queue, const std::vector<cl_event>& waits, CLEvent& event)> Command;
+
+protected:
+    struct Node
+    {
+        Command command;
+        std::function<void()> host;
+        std::vector<size_t> deps;
+        std::vector<bool>   ancestors;
+        size_t  queue;
+        CLEvent evt;
+    };
+
+    struct HostTask
+    {
+        HostTask(const std::function<void()>& func, cl_event user, cl_int pending) : func(func), user(user), pending(pending), failed(false)
+        {
+            clRetainEvent(user);
+        }
+       ~HostTask()
+        {
+            clReleaseEvent(this->user);
+        }
+
+        std::function<void()> func;
+        cl_event user;
+        std::atomic<cl_int> pending;
+        std::atomic<bool>   failed;
+    };
+
+    struct Access
+    {
+        Access() : writer(npos) {}
+
+        size_t writer;
+        std::vector<size_t> readers;
+    };
+
+public:
+    static const size_t npos = (size_t)-1;
+
+    CLGraph() : err(0)
+    {
+    }
+
+    size_t Add(const std::vector<cl_mem>& reads, const std::vector<cl_mem>& writes, const Command& command)
+    {
+        return this->Insert(reads, writes, command, nullptr);
+    }
+
+    // Kernel arguments are taken from the kernel object as they are when the graph executes.
+    size_t Kernel(const CLKernel& kernel, const std::vector<cl_mem>& reads, const std::vector<cl_mem>& writes)
+    {
+        cl_kernel handle = kernel;
+        auto dims   = kernel.Dims();
+        auto global = std::vector<size_t>(kernel.Global(), kernel.Global() + dims);
+        auto local  = kernel.Local() ? std::vector<size_t>(kernel.Local(), kernel.Local() + dims) : std::vector<size_t>();
+
+        CLKernel keep(handle);
+        return this->Add(reads, writes, [keep, dims, global, local](cl_command_queue queue, const std::vector<cl_event>& waits, CLEvent& event) -> cl_int
+        {
+            cl_event e;
+            auto error = clEnqueueNDRangeKernel(queue, keep, dims, nullptr, global.data(), local.empty() ? nullptr : local.data(),
+                                                (cl_uint)waits.size(), waits.size() ? waits.data() : nullptr, &e);
+            if (CL_SUCCESS == error)
+            {
+                event = CLEvent(e);
+                clReleaseEvent(e);
+            }
+            return error;
+        });
+    }
+
+    // Whole object copy between buffers or images, 'dst' and 'src' must outlive the graph execution.
+    template<typename Dst, typename Src>
+    size_t Copy(Dst& dst, const Src& src)
+    {
+        return this->Add({ (cl_mem)src }, { (cl_mem)dst }, [&dst, &src](cl_command_queue queue, const std::vector<cl_event>& waits, CLEvent& event) -> cl_int
+        {
+            if (!dst.Copy(queue, src, waits))
+            {
+                return dst.Error();
+            }
+            event = dst.Event();
+
+            // Event-less destinations leave a marker behind for dependent nodes.
+            if (!event)
+            {
+                CLQueue marker(queue);
+                event = marker.Marker();
+                return marker.Error();
+            }
+            return CL_SUCCESS;
+        });
+    }
+
+    // Runs 'func' on the host once its dependencies completed. Tasks without dependencies run inline in
+    // Execute(), others run on the OpenCL runtime's callback thread and must not block on OpenCL calls.
+    size_t Host(const std::vector<cl_mem>& reads, const std::vector<cl_mem>& writes, const std::function<void()>& func)
+    {
+        return this->Insert(reads, writes, nullptr, func);
+    }
+
+    // Adds an explicit ordering edge which is not expressed through memory objects.
+    void Depend(size_t node, size_t on)
+    {
+        if (node >= this->nodes.size() || on >= node)
+        {
+            throw std::runtime_error("Invalid graph dependency");
+        }
+
+        this->nodes[node].deps.push_back(on);
+
+        // Later nodes may have inherited the ancestors of 'node'.
+        for (auto i = node; i < this->nodes.size(); i++)
+        {
+            this->Reduce(this->nodes[i]);
+        }
+    }
+
+    const std::vector<size_t>& Dependencies(size_t node) const
+    {
+        return this->nodes[node].deps;
+    }
+
+    bool Execute(cl_command_queue queue)
+    {
+        return this->Execute(std::vector<cl_command_queue>{ queue });
+    }
+    bool Execute(const std::vector<cl_command_queue>& queues)
+    {
+        if (queues.empty())
+        {
+            this->err = CL_INVALID_VALUE;
+            return false;
+        }
+
+        std::vector<bool> ordered(queues.size());
+        for (size_t i = 0; i < queues.size(); i++)
+        {
+            cl_command_queue_properties properties = 0;
+            clGetCommandQueueInfo(queues[i], CL_QUEUE_PROPERTIES, sizeof(properties), &properties, nullptr);
+            ordered[i] = !(CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE & properties);
+        }
+
+        std::vector<bool> continued(this->nodes.size());
+        size_t next = 0;
+
+        this->err = CL_SUCCESS;
+        for (size_t i = 0; i < this->nodes.size(); i++)
+        {
+            auto& node = this->nodes[i];
+            node.evt = CLEvent();
+
+            // A node continues the chain of its first dependency not yet continued, otherwise it starts a new one.
+            node.queue = npos;
+            for (auto d : node.deps)
+            {
+                if (!continued[d] && this->nodes[d].command)
+                {
+                    continued[d] = true;
+                    node.queue = this->nodes[d].queue;
+                    break;
+                }
+            }
+
+            if (npos == node.queue)
+            {
+                node.queue = next++ % queues.size();
+            }
+
+            std::vector<cl_event> waits;
+            for (auto d : node.deps)
+            {
+                auto& dep = this->nodes[d];
+
+                // In-order queues already serialize commands enqueued on them.
+                if (dep.evt && !(dep.queue == node.queue && ordered[node.queue] && dep.command && node.command))
+                {
+                    waits.push_back(dep.evt);
+                }
+            }
+
+            this->err = node.command ? node.command(queues[node.queue], waits, node.evt) : this->Launch(queues[node.queue], waits, node);
+            if (CL_SUCCESS != this->err)
+            {
+                return false;
+            }
+        }
+
+        for (auto queue : queues)
+        {
+            clFlush(queue);
+        }
+
+        return true;
+    }
+
+    void Wait() const
+    {
+        std::vector<cl_event> events;
+        for (auto& node : this->nodes)
+        {
+            if (node.evt)
+            {
+                events.push_back(node.evt);
+            }
+        }
+
+        this->err = events.empty() ? CL_SUCCESS : clWaitForEvents((cl_uint)events.size(), events.data());
+    }
+
+    void Clear()
+    {
+        this->nodes.clear();
+        this->access.clear();
+    }
+
+    const CLEvent& Event(size_t node) const
+    {
+        return this->nodes[node].evt;
+    }
+
+    size_t Nodes() const
+    {
+        return this->nodes.size();
+    }
+
+    cl_int Error() const
+    {
+        return this->err;
+    }
+
+protected:
+    size_t Insert(const std::vector<cl_mem>& reads, const std::vector<cl_mem>& writes, const Command& command, const std::function<void()>& host)
+    {
+        auto index = this->nodes.size();
+
+        Node node;
+        node.command = command;
+        node.host    = host;
+        node.queue   = npos;
+
+        for (auto mem : reads)
+        {
+            auto& a = this->access[mem];
+            if (npos != a.writer)
+            {
+                node.deps.push_back(a.writer);
+            }
+        }
+
+        for (auto mem : writes)
+        {
+            auto& a = this->access[mem];
+            if (npos != a.writer)
+            {
+                node.deps.push_back(a.writer);
+            }
+
+            for (auto r : a.readers)
+            {
+                node.deps.push_back(r);
+            }
+        }
+
+        for (auto mem : reads)
+        {
+            this->access[mem].readers.push_back(index);
+        }
+
+        for (auto mem : writes)
+        {
+            auto& a = this->access[mem];
+            a.writer = index;
+            a.readers.clear();
+        }
+
+        this->nodes.push_back(std::move(node));
+        this->Reduce(this->nodes.back());
+
+        return index;
+    }
+
+    // Drops duplicated dependencies and those already implied through another dependency.
+    void Reduce(Node& node)
+    {
+        auto index = (size_t)(&node - &this->nodes[0]);
+
+        node.ancestors.assign(index, false);
+        for (auto d : node.deps)
+        {
+            if (d == index)
+            {
+                continue;
+            }
+
+            node.ancestors[d] = true;
+            auto& ancestors = this->nodes[d].ancestors;
+            for (size_t i = 0; i < ancestors.size(); i++)
+            {
+                if (ancestors[i])
+                {
+                    node.ancestors[i] = true;
+                }
+            }
+        }
+
+        std::vector<size_t> deps;
+        for (auto d : node.deps)
+        {
+            if (d == index || std::find(deps.begin(), deps.end(), d) != deps.end())
+            {
+                continue;
+            }
+
+            bool implied = false;
+            for (auto o : node.deps)
+            {
+                if (o != d && o != index && d < this->nodes[o].ancestors.size() && this->nodes[o].ancestors[d])
+                {
+                    implied = true;
+                    break;
+                }
+            }
+
+            if (!implied)
+            {
+                deps.push_back(d);
+            }
+        }
+
+        node.deps.swap(deps);
+    }
+
+    cl_int Launch(cl_command_queue queue, const std::vector<cl_event>& waits, Node& node)
+    {
+        if (waits.empty())
+        {
+            node.host();
+            return CL_SUCCESS;
+        }
+
+        cl_context context;
+        cl_int error = clGetCommandQueueInfo(queue, CL_QUEUE_CONTEXT, sizeof(context), &context, nullptr);
+        if (CL_SUCCESS != error)
+        {
+            return error;
+        }
+
+        node.evt = CLEvent::CreateUser(context, &error);
+        if (CL_SUCCESS != error)
+        {
+            return error;
+        }
+
+        auto task = std::make_shared<HostTask>(node.host, node.evt, (cl_int)waits.size());
+        for (auto e : waits)
+        {
+            error = CLEvent(e).OnComplete([task](cl_int status)
+            {
+                if (status < 0)
+                {
+                    task->failed = true;
+                }
+
+                if (0 == --task->pending)
+                {
+                    if (!task->failed)
+                    {
+                        task->func();
+                    }
+                    clSetUserEventStatus(task->user, task->failed ? CL_INVALID_EVENT_WAIT_LIST : CL_COMPLETE);
+                }
+            });
+
+            if (CL_SUCCESS != error)
+            {
+                node.evt.Signal(error);
+                return error;
+            }
+        }
+
+        return CL_SUCCESS;
+    }
+
+protected:
+    std::vector<Node> nodes;
+    std::map<cl_mem, Access> access;
+
+    mutable cl_int err;
+};
\ No newline at end of file
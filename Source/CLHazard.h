@@ -0,0 +1,74 @@
+#pragma once
+
+#include "CLEvent.h"
+#include "CLWaits.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Last writer and outstanding readers of one memory object. When tracking is enabled on a buffer or image,
+// every command touching it waits for the read-after-write, write-after-read and write-after-write hazards
+// recorded here, so no wait lists have to be maintained by hand.
+class CLHazard
+{
+public:
+    // Appends events an access has to wait for.
+    void Depends(bool write, CLWaitList& events) const
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+
+        if (this->writer)
+        {
+            events.Add(this->writer);
+        }
+
+        if (write)
+        {
+            for (auto& reader : this->readers)
+            {
+                events.Add(reader);
+            }
+        }
+    }
+
+    void Record(bool write, cl_event event)
+    {
+        if (!event)
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> guard(this->lock);
+
+        if (write)
+        {
+            this->writer = CLEvent(event);
+            this->readers.clear();
+            return;
+        }
+
+        // Keep the reader list short under read-mostly workloads.
+        if (this->readers.size() >= 16)
+        {
+            for (auto itr = this->readers.begin(); itr != this->readers.end();)
+            {
+                itr = CL_COMPLETE >= itr->Status() ? this->readers.erase(itr) : itr + 1;
+            }
+        }
+
+        this->readers.push_back(CLEvent(event));
+    }
+
+    void Reset()
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+
+        this->writer = CLEvent();
+        this->readers.clear();
+    }
+
+protected:
+    mutable std::mutex   lock;
+    CLEvent              writer;
+    std::vector<CLEvent> readers;
+};
\ No newline at end of file
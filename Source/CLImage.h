@@ -1,6 +1,13 @@
 #pragma once
 
 #include "CLCommon.h"
+#include "CLFlags.h"
+#include "CLHazard.h"
+#include "CLMemMap.h"
+#include "CLQueue.h"
+#include <initializer_list>
+#include <memory>
+#include <vector>
 
 struct CLImgDsc : cl_image_desc
 {
@@ -107,10 +114,44 @@ struct CLImgFmt : cl_image_format
     }
 };
 
+// Image origin or region with up to three components, missing ones are 'Fill' (0 for origins, 1 for
+// regions). Stored inline so passing coordinates does not allocate.
+template<size_t Fill>
+struct CLImgPos
+{
+    CLImgPos(std::initializer_list<size_t> pos)
+    {
+        this->Assign(pos.begin(), pos.size());
+    }
+    CLImgPos(const std::vector<size_t>& pos)
+    {
+        this->Assign(pos.data(), pos.size());
+    }
+
+    operator const size_t*() const
+    {
+        return this->pos;
+    }
+
+    size_t pos[3];
+
+private:
+    void Assign(const size_t* pos, size_t count)
+    {
+        for (size_t i = 0; i < 3; i++)
+        {
+            this->pos[i] = i < count ? pos[i] : Fill;
+        }
+    }
+};
+
+typedef CLImgPos<0> CLImgOrg;
+typedef CLImgPos<1> CLImgRgn;
+
 class CLImage
 {
 public:
-    CLImage() : mem(nullptr), err(0)
+    CLImage() : mem(nullptr), elem(0), err(0), eventless(false)
     {
     }
     CLImage(cl_mem image, cl_int error, const CLImgFmt& format, const CLImgDsc& descriptor) : CLImage()
@@ -123,6 +164,8 @@ public:
                 this->mem = image;
                 this->fmt = format;
                 this->dsc = descriptor;
+
+                clGetImageInfo(image, CL_IMAGE_ELEMENT_SIZE, sizeof(this->elem), &this->elem, nullptr);
             }
         }
         this->err = error;
@@ -158,6 +201,11 @@ public:
         other.dsc = dsc;
 
         this->evt = std::move(other.evt);
+        this->hzd.swap(other.hzd);
+        this->last = std::move(other.last);
+
+        std::swap(this->elem, other.elem);
+        std::swap(this->eventless, other.eventless);
 
         return *this;
     }
@@ -170,20 +218,20 @@ public:
         return this->Map<T>(queue, flags, pitch, slice, {});
     }
     template<typename T>
-    CLMemMap<T> Map(cl_command_queue queue, uint32_t flags, size_t& pitch, size_t& slice, const std::vector<cl_event>& waits)
+    CLMemMap<T> Map(cl_command_queue queue, uint32_t flags, size_t& pitch, size_t& slice, const CLWaits& waits)
     {
         return this->Map<T>(queue, flags, { 0, 0, 0 }, { this->dsc.image_width, this->dsc.image_height, this->dsc.image_depth }, pitch, slice, waits);
     }
     template<typename T>
-    CLMemMap<T> Map(cl_command_queue queue, uint32_t flags, const std::vector<size_t>& origin, const std::vector<size_t>& region,
+    CLMemMap<T> Map(cl_command_queue queue, uint32_t flags, const CLImgOrg& origin, const CLImgRgn& region,
                     size_t& pitch, size_t& slice)
     {
         ONCLEANUP(wait, [this]{ if (CL_SUCCESS == this->err) this->Wait(); });
         return this->Map<T>(queue, flags, origin, region, pitch, slice, {});
     }
     template<typename T>
-    CLMemMap<T> Map(cl_command_queue queue, uint32_t flags, const std::vector<size_t>& origin, const std::vector<size_t>& region,
-                    size_t& pitch, size_t& slice, const std::vector<cl_event>& waits)
+    CLMemMap<T> Map(cl_command_queue queue, uint32_t flags, const CLImgOrg& origin, const CLImgRgn& region,
+                    size_t& pitch, size_t& slice, const CLWaits& waits)
     {
         if (!this->mem)
         {
@@ -200,27 +248,26 @@ public:
             mflags |= CL_MAP_WRITE;
         }
 
-        std::vector<cl_event> events;
-        for (auto& e : waits)
-        {
-            if (e)
-            {
-                events.push_back(e);
-            }
-        }
+        CLWaitList events(waits);
+
+        this->Depends(!!(CLFlags::WO & flags), events);
+
+        CLProbe probe(queue, CLOp::Map, this->Bytes(region));
 
         cl_event event;
-        auto map = clEnqueueMapImage(queue, this->mem, CL_FALSE, mflags, origin.data(), region.data(), &pitch, &slice, (cl_uint)events.size(), events.size() ? events.data() : nullptr, &event, &this->err);
+        auto map = clEnqueueMapImage(queue, this->mem, CL_FALSE, mflags, origin, region, &pitch, &slice, events.Size(), events.Data(), &event, &this->err);
 
         if (CL_SUCCESS != this->err)
         {
             return CLMemMap<T>();
         }
 
+        probe.Done(event);
         this->evt = CLEvent(event);
+        this->Record(!!(CLFlags::WO & flags), event);
         clReleaseEvent(event);
 
-        return CLMemMap<T>(this->mem, queue, event, map);
+        return CLMemMap<T>(this->mem, queue, event, map, this->hzd, !!(CLFlags::WO & flags));
     }
 
     bool Copy(cl_command_queue queue, const CLImage& source)
@@ -228,40 +275,40 @@ public:
         ONCLEANUP(wait, [this]{ if (CL_SUCCESS == this->err) this->Wait(); });
         return this->Copy(queue, source, {});
     }
-    bool Copy(cl_command_queue queue, const CLImage& source, const std::vector<cl_event>& waits)
+    bool Copy(cl_command_queue queue, const CLImage& source, const CLWaits& waits)
     {
-        std::vector<size_t> region = { this->dsc.image_width  < source.dsc.image_width  ? this->dsc.image_width  : source.dsc.image_width,
+        CLImgRgn region = { this->dsc.image_width  < source.dsc.image_width  ? this->dsc.image_width  : source.dsc.image_width,
                                        this->dsc.image_height < source.dsc.image_height ? this->dsc.image_height : source.dsc.image_height,
                                        this->dsc.image_depth  < source.dsc.image_depth  ? this->dsc.image_depth  : source.dsc.image_depth };
         return this->Copy(queue, source, { 0, 0, 0 }, { 0, 0, 0 }, region, waits);
     }
-    bool Copy(cl_command_queue queue, const CLImage& source, const std::vector<size_t>& srcorg, const std::vector<size_t>& dstorg,
-              const std::vector<size_t>& region)
+    bool Copy(cl_command_queue queue, const CLImage& source, const CLImgOrg& srcorg, const CLImgOrg& dstorg,
+              const CLImgRgn& region)
     {
         ONCLEANUP(wait, [this]{ if (CL_SUCCESS == this->err) this->Wait(); });
         return this->Copy(queue, source, srcorg, dstorg, region, {});
     }
-    bool Copy(cl_command_queue queue, const CLImage& source, const std::vector<size_t>& srcorg, const std::vector<size_t>& dstorg,
-              const std::vector<size_t>& region, const std::vector<cl_event>& waits)
+    bool Copy(cl_command_queue queue, const CLImage& source, const CLImgOrg& srcorg, const CLImgOrg& dstorg,
+              const CLImgRgn& region, const CLWaits& waits)
     {
-        std::vector<cl_event> events;
-        for (auto& e : waits)
-        {
-            if (e)
-            {
-                events.push_back(e);
-            }
-        }
+        CLWaitList events(waits);
+
+        source.Depends(false, events);
+        this->Depends(true, events);
+
+        CLProbe probe(queue, CLOp::Copy, this->Bytes(region));
 
         cl_event event;
-        this->err = clEnqueueCopyImage(queue, source, this->mem, srcorg.data(), dstorg.data(), region.data(), (cl_uint)events.size(), events.size() ? events.data() : nullptr, &event);
+        this->err = clEnqueueCopyImage(queue, source, this->mem, srcorg, dstorg, region, events.Size(), events.Data(), this->Slot(event, source.Tracked() || probe.Wants()));
         if (CL_SUCCESS != this->err)
         {
             return false;
         }
 
-        this->evt = CLEvent(event);
-        clReleaseEvent(event);
+        probe.Done(event);
+        source.Record(false, event);
+        this->Record(true, event);
+        this->Retire(queue, event);
 
         return true;
     }
@@ -271,50 +318,35 @@ public:
         ONCLEANUP(wait, [this]{ if (CL_SUCCESS == this->err) this->Wait(); });
         return this->Read(queue, host, {});
     }
-    bool Read(cl_command_queue queue, void* host, const std::vector<cl_event>& waits) const
+    bool Read(cl_command_queue queue, void* host, const CLWaits& waits) const
     {
         return this->Read(queue, { 0, 0, 0 }, { this->dsc.image_width, this->dsc.image_height, this->dsc.image_depth }, host, 0, 0, waits);
     }
-    bool Read(cl_command_queue queue, const std::vector<size_t>& origin, const std::vector<size_t>& region,
+    bool Read(cl_command_queue queue, const CLImgOrg& origin, const CLImgRgn& region,
               void* host, size_t pitch, size_t slice) const
     {
         ONCLEANUP(wait, [this]{ if (CL_SUCCESS == this->err) this->Wait(); });
         return this->Read(queue, origin, region, host, pitch, slice, {});
     }
-    bool Read(cl_command_queue queue, const std::vector<size_t>& origin, const std::vector<size_t>& region,
-              void* host, size_t pitch, size_t slice, const std::vector<cl_event>& waits) const
+    bool Read(cl_command_queue queue, const CLImgOrg& origin, const CLImgRgn& region,
+              void* host, size_t pitch, size_t slice, const CLWaits& waits) const
     {
-        size_t org[3] = { 0, 0, 0 };
-        size_t rgn[3] = { 1, 1, 1 };
+        CLWaitList events(waits);
 
-        for (size_t i = 0; i < (origin.size() < 3 ? origin.size() : 3); i++)
-        {
-            org[i] = origin[i];
-        }
+        this->Depends(false, events);
 
-        for (size_t i = 0; i < (region.size() < 3 ? region.size() : 3); i++)
-        {
-            rgn[i] = region[i];
-        }
-
-        std::vector<cl_event> events;
-        for (auto& e : waits)
-        {
-            if (e)
-            {
-                events.push_back(e);
-            }
-        }
+        CLProbe probe(queue, CLOp::Read, this->Bytes(region));
 
         cl_event event;
-        this->err = clEnqueueReadImage(queue, this->mem, CL_FALSE, org, rgn, pitch, slice, host, (cl_uint)events.size(), events.size() ? events.data() : nullptr, &event);
+        this->err = clEnqueueReadImage(queue, this->mem, CL_FALSE, origin, region, pitch, slice, host, events.Size(), events.Data(), this->Slot(event, probe.Wants()));
         if (CL_SUCCESS != this->err)
         {
             return false;
         }
 
-        this->evt = CLEvent(event);
-        clReleaseEvent(event);
+        probe.Done(event);
+        this->Record(false, event);
+        this->Retire(queue, event);
 
         return true;
     }
@@ -324,57 +356,54 @@ public:
         ONCLEANUP(wait, [this]{ if (CL_SUCCESS == this->err) this->Wait(); });
         return this->Write(queue, host, {});
     }
-    bool Write(cl_command_queue queue, void* host, const std::vector<cl_event>& waits)
+    bool Write(cl_command_queue queue, void* host, const CLWaits& waits)
     {
         return this->Write(queue, { 0, 0, 0 }, { this->dsc.image_width, this->dsc.image_height, this->dsc.image_depth }, host, 0, 0, waits);
     }
-    bool Write(cl_command_queue queue, const std::vector<size_t>& origin, const std::vector<size_t>& region,
+    bool Write(cl_command_queue queue, const CLImgOrg& origin, const CLImgRgn& region,
                void* host, size_t pitch, size_t slice)
     {
         ONCLEANUP(wait, [this]{ if (CL_SUCCESS == this->err) this->Wait(); });
         return this->Write(queue, origin, region, host, pitch, slice, {});
     }
-    bool Write(cl_command_queue queue, const std::vector<size_t>& origin, const std::vector<size_t>& region,
-               void* host, size_t pitch, size_t slice, const std::vector<cl_event>& waits)
+    bool Write(cl_command_queue queue, const CLImgOrg& origin, const CLImgRgn& region,
+               void* host, size_t pitch, size_t slice, const CLWaits& waits)
     {
-        size_t org[3] = { 0, 0, 0 };
-        size_t rgn[3] = { 1, 1, 1 };
+        CLWaitList events(waits);
 
-        for (size_t i = 0; i < (origin.size() < 3 ? origin.size() : 3); i++)
-        {
-            org[i] = origin[i];
-        }
+        this->Depends(true, events);
 
-        for (size_t i = 0; i < (region.size() < 3 ? region.size() : 3); i++)
-        {
-            rgn[i] = region[i];
-        }
-
-        std::vector<cl_event> events;
-        for (auto& e : waits)
-        {
-            if (e)
-            {
-                events.push_back(e);
-            }
-        }
+        CLProbe probe(queue, CLOp::Write, this->Bytes(region));
 
         cl_event event;
-        this->err = clEnqueueWriteImage(queue, this->mem, CL_FALSE, org, rgn, pitch, slice, host, (cl_uint)events.size(), events.size() ? events.data() : nullptr, &event);
+        this->err = clEnqueueWriteImage(queue, this->mem, CL_FALSE, origin, region, pitch, slice, host, events.Size(), events.Data(), this->Slot(event, probe.Wants()));
         if (CL_SUCCESS != this->err)
         {
             return false;
         }
 
-        this->evt = CLEvent(event);
-        clReleaseEvent(event);
+        probe.Done(event);
+        this->Record(true, event);
+        this->Retire(queue, event);
 
         return true;
     }
 
     void Wait() const
     {
-        this->err = this->evt.Wait();
+        CLWaitScope scope;
+        this->err = this->evt ? this->evt.Wait() : this->Finish();
+    }
+    // Returns the positive execution status without touching Error() if 'policy' timed out.
+    cl_int Wait(const CLWaitPolicy& policy) const
+    {
+        CLWaitScope scope;
+        auto status = this->evt ? this->evt.Wait(policy) : this->Finish();
+        if (status <= CL_SUCCESS)
+        {
+            this->err = status;
+        }
+        return status;
     }
 
     size_t Width() const
@@ -410,6 +439,40 @@ public:
         return this->evt;
     }
 
+    // Opt-in hazard tracking: commands on this image wait for conflicting earlier commands by themselves.
+    void Track(bool enable)
+    {
+        if (!enable)
+        {
+            this->hzd.reset();
+        }
+        else if (!this->hzd)
+        {
+            this->hzd = std::make_shared<CLHazard>();
+        }
+    }
+    bool Tracked() const
+    {
+        return !!this->hzd;
+    }
+    const std::shared_ptr<CLHazard>& Hazard() const
+    {
+        return this->hzd;
+    }
+
+    // Opt-in event-less mode: reads, writes and copies on this image do not create events unless hazard
+    // tracking needs them. Event() is then empty and Wait() finishes the queue of the last command, order
+    // later commands through the in-order queue or a queue marker instead of wait lists. Maps keep their
+    // event since the mapped memory is only valid once it completed.
+    void Eventless(bool enable)
+    {
+        this->eventless = enable;
+    }
+    bool Eventless() const
+    {
+        return this->eventless;
+    }
+
     operator cl_event() const
     {
         return (cl_event)this->evt;
@@ -458,11 +521,72 @@ public:
         return CLImage(image, error, format, descriptor);
     }
 
+protected:
+    void Depends(bool write, CLWaitList& events) const
+    {
+        if (this->hzd)
+        {
+            this->hzd->Depends(write, events);
+        }
+    }
+    void Record(bool write, cl_event event) const
+    {
+        if (this->hzd)
+        {
+            this->hzd->Record(write, event);
+        }
+    }
+
+    size_t Bytes(const CLImgRgn& region) const
+    {
+        return region.pos[0] * region.pos[1] * region.pos[2] * this->elem;
+    }
+
+    // Where the next command returns its event, nullptr when nobody is going to wait on it.
+    cl_event* Slot(cl_event& event, bool tracked = false) const
+    {
+        event = nullptr;
+        return !this->eventless || this->hzd || tracked ? &event : nullptr;
+    }
+    // Takes over the event returned into Slot(), or remembers 'queue' for Wait() if there is none.
+    void Retire(cl_command_queue queue, cl_event event) const
+    {
+        if (event)
+        {
+            this->evt = CLEvent(event);
+            clReleaseEvent(event);
+
+            if (this->last)
+            {
+                this->last = CLQueue();
+            }
+        }
+        else
+        {
+            this->evt = CLEvent();
+
+            if (queue != this->last)
+            {
+                this->last = CLQueue(queue);
+            }
+        }
+    }
+
+    cl_int Finish() const
+    {
+        return this->last ? clFinish(this->last) : CL_SUCCESS;
+    }
+
 protected:
     cl_mem   mem;
     CLImgFmt fmt;
     CLImgDsc dsc;
+    size_t   elem;
 
     mutable cl_int  err;
     mutable CLEvent evt;
+    mutable CLQueue last;
+
+    std::shared_ptr<CLHazard> hzd;
+    bool eventless;
 };
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include "CLBuffer.h"
 #include "CLImage.h"
 #include "CLLocal.h"
+#include <atomic>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <utility>
@@ -11,7 +13,7 @@
 class CLKernel
 {
 public:
-    CLKernel() : kernel(nullptr), err(0)
+    CLKernel() : kernel(nullptr), launches(nullptr), err(0), eventless(false)
     {
     }
     CLKernel(cl_kernel kernel) : CLKernel()
@@ -42,26 +44,29 @@ public:
         ONCLEANUP(wait, [this]{ if (CL_SUCCESS == this->err) this->Wait(); });
         return this->Execute(queue, {});
     }
-    bool Execute(cl_command_queue queue, const std::vector<cl_event>& waits) const
+    bool Execute(cl_command_queue queue, const CLWaits& waits) const
     {
-        std::vector<cl_event> events;
-        for (auto e : waits)
+        CLWaitList events(waits);
+
+        this->Depends(events);
+
+        CLProbe probe(queue, CLOp::Kernel, 0, this->Work());
+        if (probe.Wants())
         {
-            if (e)
-            {
-                events.push_back(e);
-            }
+            probe.Name(this->Name());
         }
 
         cl_event event;
-        this->err = clEnqueueNDRangeKernel(queue, this->kernel, this->Dims(), nullptr, this->Global(), this->Local(), (cl_uint)events.size(), events.size() ? events.data() : nullptr, &event);
+        this->err = clEnqueueNDRangeKernel(queue, this->kernel, this->Dims(), nullptr, this->Global(), this->Local(), events.Size(), events.Data(), this->Slot(event, probe.Wants()));
         if (CL_SUCCESS != this->err)
         {
             return false;
         }
 
-        this->evt = CLEvent(event);
-        clReleaseEvent(event);
+        probe.Done(event);
+        this->Launches().fetch_add(1, std::memory_order_relaxed);
+        this->Record(event);
+        this->Retire(queue, event);
         return true;
     }
 
@@ -72,10 +77,18 @@ public:
         other.kernel = kernel;
 
         this->evt = std::move(other.evt);
+        this->name.swap(other.name);
+        std::swap(this->launches, other.launches);
 
         this->global.swap(other.global);
         this->local.swap(other.local);
 
+        this->hazards.swap(other.hazards);
+        this->access.swap(other.access);
+
+        this->last = std::move(other.last);
+        std::swap(this->eventless, other.eventless);
+
         return *this;
     }
     CLKernel& operator=(const CLKernel& other)
@@ -91,6 +104,8 @@ public:
         }
 
         this->kernel = other.kernel;
+        this->name     = other.name;
+        this->launches = other.launches;
         return *this;
     }
 
@@ -105,7 +120,19 @@ public:
 
     void Wait() const
     {
-        this->err = this->evt.Wait();
+        CLWaitScope scope;
+        this->err = this->evt ? this->evt.Wait() : this->Finish();
+    }
+    // Returns the positive execution status without touching Error() if 'policy' timed out.
+    cl_int Wait(const CLWaitPolicy& policy) const
+    {
+        CLWaitScope scope;
+        auto status = this->evt ? this->evt.Wait(policy) : this->Finish();
+        if (status <= CL_SUCCESS)
+        {
+            this->err = status;
+        }
+        return status;
     }
 
     void Size(const std::vector<size_t>& global, const std::vector<size_t>& local = {})
@@ -129,6 +156,46 @@ public:
         return (cl_uint)this->global.size();
     }
 
+    // Total number of work-items.
+    size_t Work() const
+    {
+        size_t work = this->global.empty() ? 0 : 1;
+        for (auto size : this->global)
+        {
+            work *= size;
+        }
+        return work;
+    }
+
+    // Function name, queried once.
+    const std::string& Name() const
+    {
+        if (this->name.empty() && this->kernel)
+        {
+            size_t size = 0;
+            if (CL_SUCCESS == clGetKernelInfo(this->kernel, CL_KERNEL_FUNCTION_NAME, 0, nullptr, &size) && size > 1)
+            {
+                std::string name(size, '\0');
+                if (CL_SUCCESS == clGetKernelInfo(this->kernel, CL_KERNEL_FUNCTION_NAME, size, &name[0], nullptr))
+                {
+                    name.resize(size - 1);
+                    this->name = name;
+                }
+            }
+        }
+        return this->name;
+    }
+
+    // Launch counter of this kernel's function, looked up on the first launch.
+    std::atomic<uint64_t>& Launches() const
+    {
+        if (!this->launches)
+        {
+            this->launches = &CLCounters::Global().Launches(this->Name());
+        }
+        return *this->launches;
+    }
+
     cl_int Error() const
     {
         return this->err;
@@ -140,6 +207,29 @@ public:
         return this->SetArgs(0, arg0, args...);
     }
 
+    // Declares how the kernel accesses memory argument 'index' (CLFlags::RO/WO/RW, RW by default). Only
+    // matters for buffers and images with hazard tracking enabled.
+    void Access(cl_uint index, uint32_t flags)
+    {
+        if (this->access.size() <= index)
+        {
+            this->access.resize(index + 1, (uint32_t)CLFlags::RW);
+        }
+        this->access[index] = flags;
+    }
+
+    // Opt-in event-less mode for launch-heavy loops: Execute() does not create an event unless a bound
+    // argument has hazard tracking enabled. Event() is then empty and Wait() finishes the queue of the last
+    // launch, order later commands through the in-order queue or a queue marker instead of wait lists.
+    void Eventless(bool enable)
+    {
+        this->eventless = enable;
+    }
+    bool Eventless() const
+    {
+        return this->eventless;
+    }
+
     operator cl_kernel() const
     {
         return this->kernel;
@@ -161,12 +251,14 @@ protected:
     template<typename T0>
     bool SetArgs(cl_uint index, const T0& arg0)
     {
+        this->Bind(index, nullptr);
         this->err = clSetKernelArg(this->kernel, index, sizeof(arg0), &arg0);
         return CL_SUCCESS == this->err;
     }
     template<typename T0, typename... Tx>
     bool SetArgs(cl_uint index, const T0& arg0, const Tx&... args)
     {
+        this->Bind(index, nullptr);
         this->err = clSetKernelArg(this->kernel, index, sizeof(arg0), &arg0);
         if (CL_SUCCESS != this->err)
         {
@@ -179,6 +271,7 @@ protected:
     template<typename T, size_t D>
     bool SetArgs(cl_uint index, const CLBuffer<T, D>& buffer)
     {
+        this->Bind(index, buffer.Hazard());
         auto  mem = (cl_mem)buffer;
         this->err = clSetKernelArg(this->kernel, index, sizeof(mem), &mem);
         return CL_SUCCESS == this->err;
@@ -186,6 +279,7 @@ protected:
     template<typename T, size_t D, typename... Tx>
     bool SetArgs(cl_uint index, const CLBuffer<T, D>& buffer, const Tx&... args)
     {
+        this->Bind(index, buffer.Hazard());
         auto  mem = (cl_mem)buffer;
         this->err = clSetKernelArg(this->kernel, index, sizeof(mem), &mem);
         if (CL_SUCCESS != this->err)
@@ -198,6 +292,7 @@ protected:
 
     bool SetArgs(cl_uint index, const CLImage& image)
     {
+        this->Bind(index, image.Hazard());
         auto  mem = (cl_mem)image;
         this->err = clSetKernelArg(this->kernel, index, sizeof(mem), &mem);
         return CL_SUCCESS == this->err;
@@ -205,6 +300,7 @@ protected:
     template<typename... Tx>
     bool SetArgs(cl_uint index, const CLImage& image, const Tx&... args)
     {
+        this->Bind(index, image.Hazard());
         auto  mem = (cl_mem)image;
         this->err = clSetKernelArg(this->kernel, index, sizeof(mem), &mem);
         if (CL_SUCCESS != this->err)
@@ -218,12 +314,14 @@ protected:
     template<typename T>
     bool SetArgs(cl_uint index, const CLLocal<T>& local)
     {
+        this->Bind(index, nullptr);
         this->err = clSetKernelArg(this->kernel, index, local.Size, nullptr);
         return CL_SUCCESS == this->err;
     }
     template<typename T, typename... Tx>
     bool SetArgs(cl_uint index, const CLLocal<T>& local, const Tx&... args)
     {
+        this->Bind(index, nullptr);
         this->err = clSetKernelArg(this->kernel, index, local.Size, nullptr);
         if (CL_SUCCESS != this->err)
         {
@@ -233,11 +331,103 @@ protected:
         return this->SetArgs(index + 1, args...);
     }
 
+    void Bind(cl_uint index, const std::shared_ptr<CLHazard>& hazard)
+    {
+        if (this->hazards.size() <= index)
+        {
+            if (!hazard)
+            {
+                return;
+            }
+            this->hazards.resize(index + 1);
+        }
+        this->hazards[index] = hazard;
+    }
+
+    void Depends(CLWaitList& events) const
+    {
+        for (size_t i = 0; i < this->hazards.size(); i++)
+        {
+            if (this->hazards[i])
+            {
+                this->hazards[i]->Depends(!!(CLFlags::WO & this->Access(i)), events);
+            }
+        }
+    }
+    void Record(cl_event event) const
+    {
+        for (size_t i = 0; i < this->hazards.size(); i++)
+        {
+            if (this->hazards[i])
+            {
+                this->hazards[i]->Record(!!(CLFlags::WO & this->Access(i)), event);
+            }
+        }
+    }
+
+    cl_event* Slot(cl_event& event, bool needed = false) const
+    {
+        event = nullptr;
+        if (!this->eventless || needed)
+        {
+            return &event;
+        }
+
+        for (auto& hazard : this->hazards)
+        {
+            if (hazard)
+            {
+                return &event;
+            }
+        }
+        return nullptr;
+    }
+    void Retire(cl_command_queue queue, cl_event event) const
+    {
+        if (event)
+        {
+            this->evt = CLEvent(event);
+            clReleaseEvent(event);
+
+            if (this->last)
+            {
+                this->last = CLQueue();
+            }
+        }
+        else
+        {
+            this->evt = CLEvent();
+
+            if (queue != this->last)
+            {
+                this->last = CLQueue(queue);
+            }
+        }
+    }
+
+    cl_int Finish() const
+    {
+        return this->last ? clFinish(this->last) : CL_SUCCESS;
+    }
+
+    uint32_t Access(size_t index) const
+    {
+        return index < this->access.size() ? this->access[index] : (uint32_t)CLFlags::RW;
+    }
+
 protected:
     cl_kernel kernel;
+    mutable std::string name;
+    mutable std::atomic<uint64_t>* launches;
     std::vector<size_t> global;
     std::vector<size_t> local;
 
+    std::vector<std::shared_ptr<CLHazard>> hazards;
+    std::vector<uint32_t> access;
+
     mutable cl_int  err;
     mutable CLEvent evt;
+    mutable CLQueue last;
+
+    bool eventless;
 };
\ No newline at end of file
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "CLKernel.h"
+#include "CLProgram.h"
+#include "CLProgramCache.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+// OpenCL C name of a host scalar type. Specialized on the fundamental types, so the fixed width aliases
+// resolve whichever of them they name. OpenCL C char is signed and long 64 bits wide.
+template<typename T> struct CLType;
+
+template<> struct CLType<char>               { static const char* Name() { return "char";   } };
+template<> struct CLType<signed char>        { static const char* Name() { return "char";   } };
+template<> struct CLType<unsigned char>      { static const char* Name() { return "uchar";  } };
+template<> struct CLType<short>              { static const char* Name() { return "short";  } };
+template<> struct CLType<unsigned short>     { static const char* Name() { return "ushort"; } };
+template<> struct CLType<int>                { static const char* Name() { return "int";    } };
+template<> struct CLType<unsigned int>       { static const char* Name() { return "uint";   } };
+template<> struct CLType<long>               { static const char* Name() { return sizeof(long) == 8 ? "long"  : "int";  } };
+template<> struct CLType<unsigned long>      { static const char* Name() { return sizeof(long) == 8 ? "ulong" : "uint"; } };
+template<> struct CLType<long long>          { static const char* Name() { return "long";   } };
+template<> struct CLType<unsigned long long> { static const char* Name() { return "ulong";  } };
+template<> struct CLType<float>              { static const char* Name() { return "float";  } };
+template<> struct CLType<double>             { static const char* Name() { return "double"; } };
+
+// Compile time parameters of one kernel variant, turned into -D options. Macros are kept sorted so the
+// same parameters given in any order select the same variant.
+class CLDefines
+{
+public:
+    // Binds macro 'name' to the OpenCL C type of T, e.g. Type<float>("T") gives -DT=float.
+    template<typename T>
+    CLDefines& Type(const std::string& name)
+    {
+        this->macros[name] = CLType<T>::Name();
+        return *this;
+    }
+
+    template<typename T>
+    CLDefines& Value(const std::string& name, const T& value)
+    {
+        std::ostringstream text;
+        text << value;
+        this->macros[name] = text.str();
+        return *this;
+    }
+
+    CLDefines& Value(const std::string& name, const std::string& value)
+    {
+        this->macros[name] = value;
+        return *this;
+    }
+
+    std::string Options() const
+    {
+        std::string options;
+        for (auto& macro : this->macros)
+        {
+            options += (options.empty() ? "-D" : " -D") + macro.first + "=" + macro.second;
+        }
+        return options;
+    }
+
+protected:
+    std::map<std::string, std::string> macros;
+};
+
+// Builds one program per set of compile time parameters from a single generic source and hands out its
+// kernels. Variants are built on first use and kept, so the compiler sees fixed types and sizes it can
+// unroll and vectorize for. With a CLProgramCache variants also survive restarts.
+class CLKernelVariants
+{
+public:
+    CLKernelVariants(cl_context context, const std::string& source, const std::string& options = std::string(),
+                     const std::shared_ptr<CLProgramCache>& cache = nullptr)
+        : context(context), source(source), options(options), cache(cache), built(0)
+    {
+    }
+    CLKernelVariants(const CLKernelVariants&) = delete;
+    CLKernelVariants& operator=(const CLKernelVariants&) = delete;
+
+    // Kernel 'name' of the variant built with 'defines', empty if the variant failed to build, see Log().
+    CLKernel Kernel(const std::string& name, const CLDefines& defines = CLDefines()) const
+    {
+        auto program = this->Program(defines);
+        return program ? CLKernel::Create(program, name) : CLKernel();
+    }
+
+    // Program of the variant built with 'defines', empty if it failed to build, see Log(). Each variant is
+    // built once, by the first caller, while other variants are looked up or built in parallel. Failures
+    // are kept as well and not built again.
+    CLProgram Program(const CLDefines& defines = CLDefines()) const
+    {
+        auto options = this->options;
+        auto extra = defines.Options();
+        if (!extra.empty())
+        {
+            options += options.empty() ? extra : " " + extra;
+        }
+
+        std::shared_ptr<Variant> variant;
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+
+            auto& entry = this->variants[options];
+            if (!entry)
+            {
+                entry = std::make_shared<Variant>();
+            }
+            variant = entry;
+        }
+
+        std::call_once(variant->once, [&]
+        {
+            variant->program = this->cache ? this->cache->Create(this->context, this->source.c_str(), options.c_str(), variant->log)
+                                           : CLProgram::Create(this->context, this->source.c_str(), options.c_str(), variant->log);
+
+            std::lock_guard<std::mutex> guard(this->lock);
+            if (variant->program)
+            {
+                this->built++;
+            }
+        });
+
+        if (!variant->program)
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            this->log = variant->log;
+        }
+        return variant->program;
+    }
+
+    // Build log of the last variant that failed.
+    std::string Log() const
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        return this->log;
+    }
+
+    // Variants built successfully.
+    size_t Size() const
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        return this->built;
+    }
+
+protected:
+    cl_context  context;
+    std::string source;
+    std::string options;
+    std::shared_ptr<CLProgramCache> cache;
+
+    // Written once under 'once', read only after it.
+    struct Variant
+    {
+        std::once_flag once;
+        CLProgram   program;
+        std::string log;
+    };
+
+    mutable std::mutex lock;
+    mutable std::map<std::string, std::shared_ptr<Variant>> variants;
+    mutable size_t      built;
+    mutable std::string log;
+};
\ No newline at end of file
@@ -0,0 +1,239 @@
+#pragma once
+
+#include "CLCounters.h"
+#include "CLEvent.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Log-linear histogram of nanosecond values in the spirit of HdrHistogram. Values below 128 get exact
+// buckets, larger ones 64 buckets per power of two, which keeps every reported value within 1.6% of the
+// recorded one. Recording is a relaxed increment and safe from any thread.
+class CLHistogram
+{
+public:
+    static const size_t Half    = 64;
+    static const size_t Buckets = (64 - 6) * Half + Half;
+
+    CLHistogram() : total(0), max(0)
+    {
+        for (auto& count : this->counts)
+        {
+            count = 0;
+        }
+    }
+    CLHistogram(const CLHistogram&) = delete;
+    CLHistogram& operator=(const CLHistogram&) = delete;
+
+    void Record(uint64_t ns)
+    {
+        this->counts[Index(ns)].fetch_add(1, std::memory_order_relaxed);
+        this->total.fetch_add(1, std::memory_order_relaxed);
+
+        auto max = this->max.load(std::memory_order_relaxed);
+        while (ns > max && !this->max.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    // Value at percentile 'p' in [0, 100], e.g. 50, 99 or 99.9. Zero while nothing was recorded.
+    uint64_t Percentile(double p) const
+    {
+        auto total = this->Count();
+        if (!total)
+        {
+            return 0;
+        }
+
+        auto rank = (uint64_t)(p / 100.0 * total + 0.5);
+        rank = rank < 1 ? 1 : rank > total ? total : rank;
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < Buckets; i++)
+        {
+            seen += this->counts[i].load(std::memory_order_relaxed);
+            if (seen >= rank)
+            {
+                auto value = Highest(i);
+                auto max   = this->Max();
+                return value < max ? value : max;
+            }
+        }
+        return this->Max();
+    }
+
+    uint64_t Count() const
+    {
+        return this->total.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Max() const
+    {
+        return this->max.load(std::memory_order_relaxed);
+    }
+
+    void Reset()
+    {
+        for (auto& count : this->counts)
+        {
+            count.store(0, std::memory_order_relaxed);
+        }
+        this->total.store(0, std::memory_order_relaxed);
+        this->max.store(0, std::memory_order_relaxed);
+    }
+
+protected:
+    static size_t Index(uint64_t ns)
+    {
+        if (ns < 2 * Half)
+        {
+            return (size_t)ns;
+        }
+
+        size_t msb = 63;
+        while (!(ns >> msb))
+        {
+            msb--;
+        }
+
+        auto shift = msb - 6;
+        return (shift + 1) * Half + (size_t)(ns >> shift) - Half;
+    }
+
+    // Largest value falling into bucket 'index'.
+    static uint64_t Highest(size_t index)
+    {
+        if (index < 2 * Half)
+        {
+            return index;
+        }
+
+        auto shift = index / Half - 1;
+        return ((uint64_t)(index % Half + Half + 1) << shift) - 1;
+    }
+
+protected:
+    std::atomic<uint64_t> counts[Buckets];
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> max;
+};
+
+// Latency histograms per command type and kernel name, fed from completion callbacks of the commands
+// enqueued through the wrappers while enabled. Host is the time from the enqueue call to the completion
+// callback, Device the start to end time and only filled for queues created with profiling enabled.
+// Enabling it makes every command return an event, even in event-less mode.
+class CLLatency
+{
+public:
+    struct Entry
+    {
+        CLHistogram Host;
+        CLHistogram Device;
+    };
+
+    struct Key
+    {
+        CLOp::Type  Type;
+        std::string Name;       // Kernel function name, empty for other commands
+        const Entry* Latency;
+    };
+
+    static CLLatency& Global()
+    {
+        static CLLatency latency;
+        return latency;
+    }
+
+    void Enable(bool enable)
+    {
+        this->enabled.store(enable, std::memory_order_relaxed);
+    }
+    bool Enabled() const
+    {
+        return this->enabled.load(std::memory_order_relaxed);
+    }
+
+    // Histograms of 'type' and kernel 'name', created on first use and valid for the lifetime of the process.
+    Entry& Find(CLOp::Type type, const std::string& name = std::string())
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+
+        auto& entry = this->entries[std::make_pair(type, name)];
+        if (!entry)
+        {
+            entry.reset(new Entry());
+        }
+        return *entry;
+    }
+
+    std::vector<Key> Keys() const
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+
+        std::vector<Key> keys;
+        for (auto& entry : this->entries)
+        {
+            Key key = { entry.first.first, entry.first.second, entry.second.get() };
+            keys.push_back(key);
+        }
+        return keys;
+    }
+
+    // Empties all histograms, the entries stay in place.
+    void Reset()
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+
+        for (auto& entry : this->entries)
+        {
+            entry.second->Host.Reset();
+            entry.second->Device.Reset();
+        }
+    }
+
+    // Records the latency of 'event' once it completed, 'submit' being the CLCounters::Now() of its enqueue call.
+    void Watch(CLOp::Type type, const std::string& name, uint64_t submit, cl_event event)
+    {
+        if (!event)
+        {
+            return;
+        }
+
+        auto entry = &this->Find(type, name);
+
+        CLEvent evt(event);
+        evt.OnComplete([entry, evt, submit](cl_int status)
+        {
+            if (status < 0)
+            {
+                return;
+            }
+
+            entry->Host.Record(CLCounters::Now() - submit);
+
+            auto profile = evt.Profile();
+            if (profile.End)
+            {
+                entry->Device.Record(profile.Duration());
+            }
+        });
+    }
+
+protected:
+    CLLatency() : enabled(false)
+    {
+    }
+    CLLatency(const CLLatency&) = delete;
+    CLLatency& operator=(const CLLatency&) = delete;
+
+protected:
+    std::atomic<bool> enabled;
+
+    mutable std::mutex lock;
+    std::map<std::pair<CLOp::Type, std::string>, std::unique_ptr<Entry>> entries;
+};
\ No newline at end of file
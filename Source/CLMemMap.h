@@ -1,16 +1,21 @@
 #pragma once
 
 #include "CLEvent.h"
+#include "CLHazard.h"
+#include "CLTrace.h"
+#include "CLWaits.h"
 #include <cassert>
+#include <memory>
 
 template<typename T>
 class CLMemMap
 {
 public:
-    CLMemMap() : map(nullptr), mem(nullptr), que(nullptr)
+    CLMemMap() : map(nullptr), mem(nullptr), que(nullptr), write(false)
     {
     }
-    CLMemMap(cl_mem mem, cl_command_queue queue, cl_event event, void* map) : CLMemMap()
+    CLMemMap(cl_mem mem, cl_command_queue queue, cl_event event, void* map,
+             const std::shared_ptr<CLHazard>& hazard = nullptr, bool write = false) : CLMemMap()
     {
         if (mem && CL_SUCCESS == clRetainMemObject(mem))
         {
@@ -20,6 +25,8 @@ public:
                 this->mem = mem;
                 this->que = queue;
                 this->evt = CLEvent(event);
+                this->hzd = hazard;
+                this->write = write;
             }
             else
             {
@@ -54,6 +61,9 @@ public:
         other.que = que;
         other.evt = evt;
 
+        std::swap(this->hzd,   other.hzd);
+        std::swap(this->write, other.write);
+
         return *this;
     }
     CLMemMap& operator=(const CLMemMap&) = delete;
@@ -63,27 +73,38 @@ public:
         this->Unmap({});
         this->Wait();
     }
-    void Unmap(const std::vector<cl_event>& waits)
+    void Unmap(const CLWaits& waits)
     {
         if (this->map)
         {
-            std::vector<cl_event> events;
-            for (auto& e : waits)
+            CLWaitList events(waits);
+
+            // Writes through a mapping land when it is unmapped.
+            if (this->hzd)
             {
-                if (e)
-                {
-                    events.push_back(e);
-                }
+                this->hzd->Depends(this->write, events);
             }
 
+            CLProbe probe(this->que, CLOp::Unmap);
+
             cl_event event;
-            auto err = clEnqueueUnmapMemObject(this->que, this->mem, this->map, (cl_uint)events.size(), events.size() ? events.data() : nullptr, &event);
+            auto err = clEnqueueUnmapMemObject(this->que, this->mem, this->map, events.Size(), events.Data(), &event);
             assert(CL_SUCCESS == err);
             this->map = nullptr;
             this->evt = CLEvent(event);
+            if (CL_SUCCESS == err)
+            {
+                probe.Done(event);
+            }
+            if (this->hzd && CL_SUCCESS == err)
+            {
+                this->hzd->Record(this->write, event);
+            }
             clReleaseEvent(event);
         }
 
+        this->hzd.reset();
+
         if (this->mem)
         {
             clReleaseMemObject(this->mem);
@@ -99,8 +120,14 @@ public:
 
     void Wait() const
     {
+        CLWaitScope scope;
         this->evt.Wait();
     }
+    cl_int Wait(const CLWaitPolicy& policy) const
+    {
+        CLWaitScope scope;
+        return this->evt.Wait(policy);
+    }
 
     CLEvent Event() const
     {
@@ -151,4 +178,7 @@ protected:
     cl_command_queue que;
 
     mutable CLEvent evt;
+
+    std::shared_ptr<CLHazard> hzd;
+    bool write;
 };
\ No newline at end of file
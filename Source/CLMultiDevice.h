@@ -0,0 +1,566 @@
+#pragma once
+
+#include "CLContext.h"
+#include "CLKernel.h"
+#include "CLQueue.h"
+#include <chrono>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Splits a kernel's NDRange across every device of one context. The slowest varying dimension is
+// partitioned proportionally to each device's throughput in units of that dimension per second, measured
+// from the profiling times of every completed execution. Devices without a measurement yet are estimated
+// from compute units * clock, scaled by the ratio of measured rate to estimate of the others. Every device
+// keeps at least one work-group while there are enough of them, so all of them keep being measured.
+class CLMultiDevice
+{
+    struct Lane
+    {
+        Lane(const CLDevice& device) : device(device), scratch(nullptr), size(0), offset(0), count(0), rate(0), seed(1), measured(false)
+        {
+        }
+        Lane(Lane&& other) : Lane(other.device)
+        {
+            *this = std::move(other);
+        }
+        Lane(const Lane&) = delete;
+       ~Lane()
+        {
+            if (this->scratch)
+            {
+                clReleaseMemObject(this->scratch);
+            }
+        }
+
+        Lane& operator=(Lane&& other)
+        {
+            std::swap(this->device,  other.device);
+            std::swap(this->queue,   other.queue);
+            std::swap(this->scratch, other.scratch);
+            std::swap(this->size,    other.size);
+            std::swap(this->offset,  other.offset);
+            std::swap(this->count,   other.count);
+            std::swap(this->rate,    other.rate);
+            std::swap(this->seed,    other.seed);
+            std::swap(this->measured, other.measured);
+            std::swap(this->exec,    other.exec);
+            return *this;
+        }
+        Lane& operator=(const Lane&) = delete;
+
+        CLDevice device;
+        CLQueue  queue;
+        cl_mem   scratch;
+        size_t   size;
+        size_t   offset;
+        size_t   count;
+        double   rate;          // Measured units per second, valid once 'measured'
+        double   seed;          // Compute units * clock estimate
+        bool     measured;
+        CLEvent  exec;
+    };
+
+public:
+    CLMultiDevice() : err(0), smoothing(0.5)
+    {
+    }
+    CLMultiDevice(CLMultiDevice&& other) : CLMultiDevice()
+    {
+        *this = std::move(other);
+    }
+    CLMultiDevice(const CLMultiDevice&) = delete;
+    virtual ~CLMultiDevice()
+    {
+    }
+
+    CLMultiDevice& operator=(CLMultiDevice&& other)
+    {
+        std::swap(this->context,   other.context);
+        std::swap(this->lanes,     other.lanes);
+        std::swap(this->err,       other.err);
+        std::swap(this->evt,       other.evt);
+        std::swap(this->smoothing, other.smoothing);
+        return *this;
+    }
+    CLMultiDevice& operator=(const CLMultiDevice&) = delete;
+
+    // Executes 'kernel' across all devices. Argument 'index' of the kernel must be the 1d 'output' buffer,
+    // and each unit of the partitioned dimension writes 'stride' consecutive elements of it (0 means the
+    // product of the other global sizes, i.e. one row or slice per unit). The kernel must only write the
+    // output; devices other than the primary one compute into private scratch buffers which are gathered
+    // back into 'output' once they finish.
+    template<typename T>
+    bool Execute(const CLKernel& kernel, cl_uint index, CLBuffer<T>& output, size_t stride = 0)
+    {
+        ONCLEANUP(wait, [this]{ if (CL_SUCCESS == this->err) this->Wait(); });
+        return this->Execute(kernel, index, output, stride, {});
+    }
+    template<typename T>
+    bool Execute(const CLKernel& kernel, cl_uint index, CLBuffer<T>& output, size_t stride, const std::vector<cl_event>& waits)
+    {
+        return this->Execute(kernel, index, (cl_mem)output, output.Length() * sizeof(T), sizeof(T), stride, waits);
+    }
+
+    // Runs the whole range once on every device in turn and seeds the shares with the measured rates.
+    bool Calibrate(const CLKernel& kernel)
+    {
+        auto dims = kernel.Dims();
+        if (!kernel || !dims || this->lanes.empty())
+        {
+            this->err = CL_INVALID_KERNEL;
+            return false;
+        }
+
+        auto dim   = dims - 1;
+        auto total = kernel.Global()[dim];
+
+        for (auto& lane : this->lanes)
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            cl_event event;
+            this->err = clEnqueueNDRangeKernel(lane.queue, kernel, dims, nullptr, kernel.Global(), kernel.Local(), 0, nullptr, &event);
+            if (CL_SUCCESS != this->err)
+            {
+                return false;
+            }
+
+            CLEvent exec(event);
+            clReleaseEvent(event);
+
+            this->err = exec.Wait();
+            if (CL_SUCCESS != this->err)
+            {
+                return false;
+            }
+
+            // Host time only if the device reports no profiling times.
+            auto elapsed = exec.Profile().Duration() * 1e-9;
+            if (elapsed <= 0)
+            {
+                elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+
+            if (elapsed > 0)
+            {
+                lane.rate     = total / elapsed;
+                lane.measured = true;
+            }
+        }
+
+        return true;
+    }
+
+    void Wait() const
+    {
+        std::vector<cl_event> events;
+        for (auto& lane : this->lanes)
+        {
+            if (lane.exec)
+            {
+                events.push_back(lane.exec);
+            }
+        }
+
+        if (this->evt)
+        {
+            events.push_back(this->evt);
+        }
+
+        this->err = events.empty() ? CL_SUCCESS : clWaitForEvents((cl_uint)events.size(), events.data());
+        if (CL_SUCCESS == this->err)
+        {
+            this->Rebalance();
+        }
+    }
+
+    // Weight of the latest timing sample in the throughput moving average, in (0, 1].
+    void Smoothing(double smoothing)
+    {
+        this->smoothing = smoothing > 0 && smoothing <= 1 ? smoothing : 1;
+    }
+
+    double Share(size_t device) const
+    {
+        double sum = 0;
+        for (size_t i = 0; i < this->lanes.size(); i++)
+        {
+            sum += this->Rate(i);
+        }
+
+        return sum > 0 ? this->Rate(device) / sum : 0;
+    }
+
+    // Throughput of 'device' in units of the partitioned dimension per second, estimated until its first
+    // execution was measured.
+    double Rate(size_t device) const
+    {
+        auto& lane = this->lanes[device];
+        if (lane.measured)
+        {
+            return lane.rate;
+        }
+
+        double scale = 0;
+        size_t measured = 0;
+        for (auto& other : this->lanes)
+        {
+            if (other.measured)
+            {
+                scale += other.rate / other.seed;
+                measured++;
+            }
+        }
+        return measured ? lane.seed * scale / measured : lane.seed;
+    }
+
+    size_t Devices() const
+    {
+        return this->lanes.size();
+    }
+
+    const CLDevice& Device(size_t index) const
+    {
+        return this->lanes[index].device;
+    }
+
+    const CLQueue& Queue(size_t index) const
+    {
+        return this->lanes[index].queue;
+    }
+
+    const CLContext& Context() const
+    {
+        return this->context;
+    }
+
+    cl_int Error() const
+    {
+        return this->err;
+    }
+
+    CLEvent Event() const
+    {
+        return this->evt;
+    }
+
+    operator cl_event() const
+    {
+        return (cl_event)this->evt;
+    }
+
+    operator cl_context() const
+    {
+        return this->context;
+    }
+
+    operator bool() const
+    {
+        return !!this->context && !this->lanes.empty();
+    }
+
+    // All devices have to belong to the same platform for them to share one context.
+    static CLMultiDevice Create(const std::vector<CLDevice>& devices)
+    {
+        CLMultiDevice multi;
+        if (devices.empty())
+        {
+            return multi;
+        }
+
+        std::vector<cl_device_id> ids;
+        for (auto& device : devices)
+        {
+            if (device.Platform() != devices[0].Platform())
+            {
+                return multi;
+            }
+            ids.push_back(device);
+        }
+
+        multi.context = CLContext::Create(ids);
+        if (!multi.context)
+        {
+            return multi;
+        }
+
+        for (auto& device : devices)
+        {
+            // Profiling times measure each share without host side latency.
+            CLQueueOptions options;
+            options.Profiling = true;
+
+            Lane lane(device);
+            lane.queue = CLQueue::Create(multi.context, device, options);
+            if (!lane.queue)
+            {
+                return CLMultiDevice();
+            }
+
+            lane.seed = (double)(device.MaxComputeUnits() * device.MaxClockFrequency());
+            if (lane.seed <= 0)
+            {
+                lane.seed = 1;
+            }
+
+            multi.lanes.push_back(std::move(lane));
+        }
+
+        return multi;
+    }
+    // Picks the platform with the largest estimated GPU and CPU throughput and uses all of those devices.
+    static CLMultiDevice CreateDefault()
+    {
+        std::vector<CLDevice> selected;
+        double best = 0;
+
+        for (auto& platform : CLPlatform::Platforms())
+        {
+            std::vector<CLDevice> devices;
+            double estimate = 0;
+
+            for (auto& device : platform.Devices())
+            {
+                auto type = device.Type();
+                if (CL_DEVICE_TYPE_GPU & type || CL_DEVICE_TYPE_CPU & type)
+                {
+                    devices.push_back(device);
+                    estimate += (double)(device.MaxComputeUnits() * device.MaxClockFrequency());
+                }
+            }
+
+            if (!devices.empty() && (selected.empty() || estimate > best))
+            {
+                selected = devices;
+                best = estimate;
+            }
+        }
+
+        return Create(selected);
+    }
+
+protected:
+    bool Execute(const CLKernel& kernel, cl_uint index, cl_mem output, size_t bytes, size_t elem, size_t stride, const std::vector<cl_event>& waits)
+    {
+        auto dims = kernel.Dims();
+        if (!kernel || !dims || !output || this->lanes.empty())
+        {
+            this->err = CL_INVALID_VALUE;
+            return false;
+        }
+
+        auto dim   = dims - 1;
+        auto total = kernel.Global()[dim];
+        auto group = kernel.Local() ? kernel.Local()[dim] : 1;
+
+        if (0 == stride)
+        {
+            stride = 1;
+            for (cl_uint i = 0; i < dim; i++)
+            {
+                stride *= kernel.Global()[i];
+            }
+        }
+
+        if (total * stride * elem > bytes)
+        {
+            this->err = CL_INVALID_GLOBAL_WORK_SIZE;
+            return false;
+        }
+
+        // Callers of the asynchronous overload may never Wait(), fold in whatever finished since the last run.
+        this->Rebalance();
+        this->Partition(total, group);
+
+        // The lane with the largest share writes the output in place, others go through scratch buffers.
+        size_t primary = 0;
+        for (size_t i = 1; i < this->lanes.size(); i++)
+        {
+            if (this->lanes[i].count > this->lanes[primary].count)
+            {
+                primary = i;
+            }
+        }
+
+        std::vector<cl_event> events;
+        for (auto& e : waits)
+        {
+            if (e)
+            {
+                events.push_back(e);
+            }
+        }
+
+        size_t offset[3] = { 0, 0, 0 };
+        size_t global[3] = { 0, 0, 0 };
+        for (cl_uint i = 0; i < dims; i++)
+        {
+            global[i] = kernel.Global()[i];
+        }
+
+        ONCLEANUP(output, [&]{ clSetKernelArg(kernel, index, sizeof(output), &output); });
+
+        this->evt = CLEvent();
+        for (size_t i = 0; i < this->lanes.size(); i++)
+        {
+            auto& lane = this->lanes[i];
+            lane.exec  = CLEvent();
+
+            if (!lane.count)
+            {
+                continue;
+            }
+
+            auto mem = output;
+            if (i != primary)
+            {
+                if (lane.size < bytes)
+                {
+                    if (lane.scratch)
+                    {
+                        clReleaseMemObject(lane.scratch);
+                        lane.scratch = nullptr;
+                        lane.size = 0;
+                    }
+
+                    lane.scratch = clCreateBuffer(this->context, CL_MEM_READ_WRITE, bytes, nullptr, &this->err);
+                    if (CL_SUCCESS != this->err)
+                    {
+                        lane.scratch = nullptr;
+                        return false;
+                    }
+                    lane.size = bytes;
+                }
+                mem = lane.scratch;
+            }
+
+            this->err = clSetKernelArg(kernel, index, sizeof(mem), &mem);
+            if (CL_SUCCESS != this->err)
+            {
+                return false;
+            }
+
+            offset[dim] = lane.offset;
+            global[dim] = lane.count;
+
+            cl_event event;
+            this->err = clEnqueueNDRangeKernel(lane.queue, kernel, dims, offset, global, kernel.Local(),
+                                               (cl_uint)events.size(), events.size() ? events.data() : nullptr, &event);
+            if (CL_SUCCESS != this->err)
+            {
+                return false;
+            }
+
+            lane.exec = CLEvent(event);
+            clReleaseEvent(event);
+
+            clFlush(lane.queue);
+        }
+
+        // Gather scratch partitions one after another so that no two devices write 'output' at once.
+        CLEvent last = this->lanes[primary].exec;
+        for (size_t i = 0; i < this->lanes.size(); i++)
+        {
+            auto& lane = this->lanes[i];
+            if (i == primary || !lane.count)
+            {
+                continue;
+            }
+
+            auto from = lane.offset * stride * elem;
+            auto size = lane.count  * stride * elem;
+
+            cl_event deps[2] = { lane.exec, last };
+            cl_event event;
+            this->err = clEnqueueCopyBuffer(lane.queue, lane.scratch, output, from, from, size, 2, deps, &event);
+            if (CL_SUCCESS != this->err)
+            {
+                return false;
+            }
+
+            last = CLEvent(event);
+            clReleaseEvent(event);
+        }
+
+        this->evt = last;
+        return true;
+    }
+
+    void Partition(size_t total, size_t group) const
+    {
+        std::vector<double> rates;
+        double sum = 0;
+        for (size_t i = 0; i < this->lanes.size(); i++)
+        {
+            rates.push_back(this->Rate(i));
+            sum += rates.back();
+        }
+
+        size_t fastest = 0;
+        size_t offset  = 0;
+        size_t groups  = total / group;
+
+        // One group each first, so slow devices are still measured and can win back a larger share.
+        size_t reserved = groups >= this->lanes.size() ? 1 : 0;
+        size_t spread   = groups - reserved * this->lanes.size();
+
+        for (size_t i = 0; i < this->lanes.size(); i++)
+        {
+            auto& lane = this->lanes[i];
+            if (rates[i] > rates[fastest])
+            {
+                fastest = i;
+            }
+
+            lane.count = (reserved + (sum > 0 ? (size_t)(spread * rates[i] / sum) : 0)) * group;
+        }
+
+        // Rounding leftovers go to the fastest device.
+        size_t assigned = 0;
+        for (auto& lane : this->lanes)
+        {
+            assigned += lane.count;
+        }
+        this->lanes[fastest].count += total - assigned;
+
+        for (auto& lane : this->lanes)
+        {
+            lane.offset = offset;
+            offset += lane.count;
+        }
+    }
+
+    // Folds the profiled duration of every finished share into its rate, once per execution. Shares still
+    // running are left for a later call.
+    void Rebalance() const
+    {
+        for (auto& lane : this->lanes)
+        {
+            if (!lane.exec || !lane.count || CL_COMPLETE != lane.exec.Status())
+            {
+                continue;
+            }
+
+            auto duration = lane.exec.Profile().Duration();
+            lane.exec = CLEvent();
+            if (!duration)
+            {
+                continue;
+            }
+
+            auto sample = lane.count / (duration * 1e-9);
+            lane.rate     = lane.measured ? lane.rate * (1 - this->smoothing) + sample * this->smoothing : sample;
+            lane.measured = true;
+        }
+    }
+
+protected:
+    CLContext context;
+    mutable std::vector<Lane> lanes;
+
+    mutable cl_int  err;
+    mutable CLEvent evt;
+
+    double smoothing;
+};
\ No newline at end of file
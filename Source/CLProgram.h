@@ -1,9 +1,19 @@
 #pragma once
 
 #include "CLCommon.h"
+#include "CLCounters.h"
+#include "CLKernel.h"
+#include <CL/cl.h>
+#include <atomic>
 #include <iostream>
+#include <map>
 #include <cstring>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 class CLProgram
 {
@@ -16,6 +26,7 @@ public:
         if (program && CL_SUCCESS == clRetainProgram(program))
         {
             this->program = program;
+            this->kernels = std::make_shared<KernelCache>();
         }
     }
     CLProgram(CLProgram&& other) : CLProgram()
@@ -39,6 +50,8 @@ public:
         cl_program program = this->program;
         this->program = other.program;
         other.program = program;
+
+        this->kernels.swap(other.kernels);
         return *this;
     }
     CLProgram& operator=(const CLProgram& other)
@@ -54,10 +67,101 @@ public:
         }
 
         this->program = other.program;
+        this->kernels = other.kernels;
         return *this;
     }
 
-    bool GetBinary(std::vector<std::vector<uint8_t>>& binaries)
+    // Creates one kernel object for every kernel function of the program in a single call.
+    std::vector<CLKernel> Kernels() const
+    {
+        std::vector<CLKernel> kernels;
+
+        cl_uint count = 0;
+        if (!this->program || CL_SUCCESS != clCreateKernelsInProgram(this->program, 0, nullptr, &count) || !count)
+        {
+            return kernels;
+        }
+
+        std::vector<cl_kernel> handles(count);
+        if (CL_SUCCESS != clCreateKernelsInProgram(this->program, count, handles.data(), nullptr))
+        {
+            return kernels;
+        }
+
+        for (auto handle : handles)
+        {
+            kernels.push_back(CLKernel(handle));
+            clReleaseKernel(handle);
+        }
+        return kernels;
+    }
+
+    // Kernel 'name' shared by all copies of this program, all kernels are created with Kernels() on the
+    // first lookup and later ones only hit the cache. Arguments and sizes set on it are shared as well,
+    // threads launching it concurrently take a Clone() each. Empty if the program has no such kernel, that
+    // one is local to the calling thread and reset on every lookup.
+    CLKernel& Kernel(const std::string& name) const
+    {
+        if (!this->kernels)
+        {
+            throw std::runtime_error("Kernel lookup on an empty program");
+        }
+
+        auto& cache = *this->kernels;
+        std::lock_guard<std::mutex> guard(cache.lock);
+
+        if (!cache.filled)
+        {
+            for (auto& kernel : this->Kernels())
+            {
+                auto function = kernel.Name();
+                cache.kernels.emplace(function, std::move(kernel));
+            }
+            cache.filled = true;
+        }
+
+        auto itr = cache.kernels.find(name);
+        if (itr == cache.kernels.end())
+        {
+            static thread_local CLKernel none;
+            none = CLKernel();
+            return none;
+        }
+        return itr->second;
+    }
+
+    // New kernel object for 'name' without arguments, independent from the shared one. Where clCloneKernel
+    // is available it clones a kernel which is never handed out, under the cache lock, so it does not race
+    // with arguments being set on the shared kernel.
+    CLKernel Clone(const std::string& name) const
+    {
+        if (!this->Kernel(name))
+        {
+            return CLKernel();
+        }
+
+#if CL_TARGET_OPENCL_VERSION >= 210
+        auto& cache = *this->kernels;
+        std::lock_guard<std::mutex> guard(cache.lock);
+
+        auto& pristine = cache.pristine[name];
+        if (!pristine)
+        {
+            pristine = CLKernel::Create(this->program, name);
+        }
+
+        cl_int error;
+        auto clone = pristine ? clCloneKernel(pristine, &error) : nullptr;
+        if (clone && CL_SUCCESS == error)
+        {
+            ONCLEANUP(clone, [=]{ clReleaseKernel(clone); });
+            return CLKernel(clone);
+        }
+#endif
+        return CLKernel::Create(this->program, name);
+    }
+
+    bool GetBinary(std::vector<std::vector<uint8_t>>& binaries) const
     {
         if (!this->program)
         {
@@ -97,7 +201,7 @@ public:
         return true;
     }
 
-    bool Save(std::ostream& stream)
+    bool Save(std::ostream& stream) const
     {
         std::vector<std::vector<uint8_t>> binaries;
         if (!this->GetBinary(binaries))
@@ -127,180 +231,269 @@ public:
 
     static CLProgram Create(cl_context context, const char* source, const char* options, std::string& log)
     {
-        size_t size;
-        cl_int error = clGetContextInfo(context, CL_CONTEXT_DEVICES, 0, nullptr, &size);
-        if (CL_SUCCESS != error)
+        std::vector<cl_device_id> devices;
+        if (!Devices(context, devices, log))
         {
-            log = "Failed to get context devices number";
             return CLProgram();
         }
 
-        std::vector<cl_device_id> devices(size / sizeof(cl_device_id));
-        if (devices.empty())
+        return Create(context, devices, source, options, log);
+    }
+    // Builds for 'devices' of 'context' only, e.g. one device at a time to build in parallel.
+    static CLProgram Create(cl_context context, const std::vector<cl_device_id>& devices, const char* source, const char* options, std::string& log)
+    {
+        cl_int error;
+        auto length = strlen(source);
+        auto program = clCreateProgramWithSource(context, 1, &source, &length, &error);
+        if (CL_SUCCESS != error)
         {
-            log = "No associated devices to context";
+            log = "Failed to create program";
             return CLProgram();
         }
+        ONCLEANUP(program, [=]{ clReleaseProgram(program); });
 
-        error = clGetContextInfo(context, CL_CONTEXT_DEVICES, size, &devices[0], nullptr);
+        auto start = CLCounters::Now();
+        error = clBuildProgram(program, (cl_uint)devices.size(), devices.data(), options, nullptr, nullptr);
+        CLCounters::Global().Built(CLCounters::Now() - start);
         if (CL_SUCCESS != error)
         {
-            log = "Failed to get context devices";
+            log = "Failed to build program\n";
+            BuildLog(program, devices, log);
             return CLProgram();
         }
 
-        auto length = strlen(source);
-        auto program = clCreateProgramWithSource(context, 1, &source, &length, &error);
+        return CLProgram(program);
+    }
+    static CLProgram Create(cl_context context, std::istream& source, const char* options, std::string& log)
+    {
+        return Create(context, std::string(std::istreambuf_iterator<char>(source), std::istreambuf_iterator<char>()).c_str(), options, log);
+    }
+
+    // Starts the build through the pfn_notify callback and returns right away, the future is ready once the
+    // driver finished. 'log' is written before that and has to stay valid until then. Drivers which build
+    // inside clBuildProgram anyway gain nothing, use CLProgramBuilder to build several programs at once.
+    static std::future<CLProgram> CreateAsync(cl_context context, const char* source, const char* options, std::string& log);
+
+#if CL_TARGET_OPENCL_VERSION >= 210
+    // Builds a program from an intermediate language module such as SPIR-V compiled offline, which skips
+    // the front end at startup. 'options' only affect the device specific finalization.
+    static CLProgram CreateFromIL(cl_context context, const void* il, size_t size, const char* options, std::string& log)
+    {
+        if (!il || !size)
+        {
+            log = "Empty intermediate language module";
+            return CLProgram();
+        }
+
+        std::vector<cl_device_id> devices;
+        if (!Devices(context, devices, log))
+        {
+            return CLProgram();
+        }
+
+        cl_int error;
+        auto program = clCreateProgramWithIL(context, il, size, &error);
         if (CL_SUCCESS != error)
         {
-            log = "Failed to create program";
+            log = "Failed to create program from intermediate language";
             return CLProgram();
         }
         ONCLEANUP(program, [=]{ clReleaseProgram(program); });
 
+        auto start = CLCounters::Now();
         error = clBuildProgram(program, (cl_uint)devices.size(), devices.data(), options, nullptr, nullptr);
+        CLCounters::Global().Built(CLCounters::Now() - start);
         if (CL_SUCCESS != error)
         {
             log = "Failed to build program\n";
-
-            for (auto device : devices)
-            {
-                cl_build_status status;
-                error = clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_STATUS, sizeof(status), &status, nullptr);
-                if (CL_SUCCESS != error)
-                {
-                    log += "Failed to get program build status";
-                    break;
-                }
-
-                if (CL_BUILD_ERROR == status)
-                {
-                    error = clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &size);
-                    if (CL_SUCCESS != error)
-                    {
-                        log += "Failed to get program build log length";
-                        break;
-                    }
-
-                    std::string err;
-                    err.resize(size);
-
-                    error = clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, size, &err[0], nullptr);
-                    if (CL_SUCCESS != error)
-                    {
-                        log += "Failed to get program build log";
-                        break;
-                    }
-
-                    err.resize(err.size() - 1);
-                    log += err;
-                    break;
-                }
-            }
-
+            BuildLog(program, devices, log);
             return CLProgram();
         }
 
         return CLProgram(program);
     }
-    static CLProgram Create(cl_context context, std::istream& source, const char* options, std::string& log)
+    static CLProgram CreateFromIL(cl_context context, const std::vector<uint8_t>& il, const char* options, std::string& log)
     {
-        return Create(context, std::string(std::istreambuf_iterator<char>(source), std::istreambuf_iterator<char>()).c_str(), options, log);
+        return CreateFromIL(context, il.data(), il.size(), options, log);
     }
+    static CLProgram CreateFromIL(cl_context context, std::istream& stream, const char* options, std::string& log)
+    {
+        return CreateFromIL(context, std::vector<uint8_t>(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()), options, log);
+    }
+#endif
 
-    static CLProgram Load(cl_context context, const std::vector<std::vector<uint8_t>>& binaries, std::string& log, std::vector<cl_int>* status = nullptr)
+    // Compiles 'source' into an object for Link(). 'headers' maps include names to their source, so
+    // #include "name" resolves from memory and shared helpers are not read from disk.
+    static CLProgram Compile(cl_context context, const char* source, const std::map<std::string, std::string>& headers, const char* options, std::string& log)
     {
-        if (binaries.empty())
+        std::vector<cl_device_id> devices;
+        if (!Devices(context, devices, log))
         {
             return CLProgram();
         }
 
-        size_t size;
-        cl_int error = clGetContextInfo(context, CL_CONTEXT_DEVICES, 0, nullptr, &size);
+        std::vector<cl_program> programs;
+        std::vector<const char*> names;
+        ONCLEANUP(headers, [&]{ for (auto header : programs) clReleaseProgram(header); });
+
+        cl_int error;
+        for (auto& header : headers)
+        {
+            auto text   = header.second.c_str();
+            auto length = header.second.size();
+            auto program = clCreateProgramWithSource(context, 1, &text, &length, &error);
+            if (CL_SUCCESS != error)
+            {
+                log = "Failed to create header " + header.first;
+                return CLProgram();
+            }
+            programs.push_back(program);
+            names.push_back(header.first.c_str());
+        }
+
+        auto length = strlen(source);
+        auto program = clCreateProgramWithSource(context, 1, &source, &length, &error);
         if (CL_SUCCESS != error)
         {
-            log = "Failed to get context devices number";
+            log = "Failed to create program";
             return CLProgram();
         }
+        ONCLEANUP(program, [=]{ clReleaseProgram(program); });
 
-        std::vector<cl_device_id> devices(size / sizeof(cl_device_id));
-        if (devices.empty())
+        auto start = CLCounters::Now();
+        error = clCompileProgram(program, (cl_uint)devices.size(), devices.data(), options, (cl_uint)programs.size(),
+                                 programs.empty() ? nullptr : programs.data(), names.empty() ? nullptr : names.data(), nullptr, nullptr);
+        CLCounters::Global().Built(CLCounters::Now() - start);
+        if (CL_SUCCESS != error)
         {
-            log = "No associated devices to context";
+            log = "Failed to compile program\n";
+            BuildLog(program, devices, log);
             return CLProgram();
         }
 
-        error = clGetContextInfo(context, CL_CONTEXT_DEVICES, size, &devices[0], nullptr);
-        if (CL_SUCCESS != error)
+        return CLProgram(program);
+    }
+
+    // Links compiled objects and libraries into an executable program, or into another library if
+    // 'options' contain -create-library.
+    static CLProgram Link(cl_context context, const std::vector<CLProgram>& programs, const char* options, std::string& log)
+    {
+        std::vector<cl_device_id> devices;
+        if (!Devices(context, devices, log))
         {
-            log = "Failed to get context devices";
             return CLProgram();
         }
 
-        std::vector<size_t> lengths;
-        std::vector<const uint8_t*> pointers;
-        for (auto& binary : binaries)
+        std::vector<cl_program> inputs;
+        for (auto& program : programs)
         {
-            lengths.push_back(binary.size());
-            pointers.push_back(binary.data());
+            inputs.push_back(program);
         }
 
-        if (status)
+        if (inputs.empty())
         {
-            status->resize(binaries.size());
+            log = "No programs to link";
+            return CLProgram();
         }
 
-        auto program = clCreateProgramWithBinary(context, (cl_uint)devices.size(), devices.data(), lengths.data(), pointers.data(), status ? &(*status)[0] : nullptr, &error);
+        cl_int error;
+        auto start = CLCounters::Now();
+        auto program = clLinkProgram(context, (cl_uint)devices.size(), devices.data(), options, (cl_uint)inputs.size(), inputs.data(), nullptr, nullptr, &error);
+        CLCounters::Global().Built(CLCounters::Now() - start);
 
+        // A failed link may still return a program holding the log.
+        ONCLEANUP(program, [=]{ if (program) clReleaseProgram(program); });
         if (CL_SUCCESS != error)
         {
-            log = "Failed to create program";
+            log = "Failed to link program\n";
+            if (program)
+            {
+                BuildLog(program, devices, log);
+            }
             return CLProgram();
         }
-        ONCLEANUP(program, [=]{ clReleaseProgram(program); });
 
-        error = clBuildProgram(program, (cl_uint)devices.size(), devices.data(), nullptr, nullptr, nullptr);
+        return CLProgram(program);
+    }
+
+    // Library of 'programs' to be linked again with other objects.
+    static CLProgram Library(cl_context context, const std::vector<CLProgram>& programs, const char* options, std::string& log)
+    {
+        auto library = std::string("-create-library ") + (options ? options : "");
+        return Link(context, programs, library.c_str(), log);
+    }
+
+    static CLProgram Load(cl_context context, const std::vector<std::vector<uint8_t>>& binaries, std::string& log, std::vector<cl_int>* status = nullptr)
+    {
+        std::vector<const uint8_t*> pointers;
+        std::vector<size_t> sizes;
+        Pointers(binaries, pointers, sizes);
+
+        return Load(context, pointers, sizes, log, status);
+    }
+    // Binaries already in memory, e.g. mapped by CLProgramBundle, go to the driver without a copy.
+    static CLProgram Load(cl_context context, const std::vector<const uint8_t*>& binaries, const std::vector<size_t>& sizes, std::string& log, std::vector<cl_int>* status = nullptr)
+    {
+        auto program = LoadObject(context, binaries, sizes, log, status);
+        if (!program)
+        {
+            return CLProgram();
+        }
+
+        std::vector<cl_device_id> devices;
+        if (!Devices(context, devices, log))
+        {
+            return CLProgram();
+        }
+
+        auto start = CLCounters::Now();
+        cl_int error = clBuildProgram(program, (cl_uint)devices.size(), devices.data(), nullptr, nullptr, nullptr);
+        CLCounters::Global().Built(CLCounters::Now() - start);
         if (CL_SUCCESS != error)
         {
             log = "Failed to build program\n";
+            BuildLog(program, devices, log);
+            return CLProgram();
+        }
 
-            for (auto device : devices)
-            {
-                cl_build_status status;
-                error = clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_STATUS, sizeof(status), &status, nullptr);
-                if (CL_SUCCESS != error)
-                {
-                    log += "Failed to get program build status";
-                    break;
-                }
+        return program;
+    }
+    // Binaries of compiled objects or libraries go to Link() as they are, without a build.
+    static CLProgram LoadObject(cl_context context, const std::vector<std::vector<uint8_t>>& binaries, std::string& log, std::vector<cl_int>* status = nullptr)
+    {
+        std::vector<const uint8_t*> pointers;
+        std::vector<size_t> sizes;
+        Pointers(binaries, pointers, sizes);
 
-                if (CL_BUILD_ERROR == status)
-                {
-                    error = clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &size);
-                    if (CL_SUCCESS != error)
-                    {
-                        log += "Failed to get program build log length";
-                        break;
-                    }
-
-                    std::string err;
-                    err.resize(size);
-
-                    error = clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, size, &err[0], nullptr);
-                    if (CL_SUCCESS != error)
-                    {
-                        log += "Failed to get program build log";
-                        break;
-                    }
-
-                    err.resize(err.size() - 1);
-                    log += err;
-                    break;
-                }
-            }
+        return LoadObject(context, pointers, sizes, log, status);
+    }
+    static CLProgram LoadObject(cl_context context, const std::vector<const uint8_t*>& binaries, const std::vector<size_t>& sizes, std::string& log, std::vector<cl_int>* status = nullptr)
+    {
+        if (binaries.empty() || binaries.size() != sizes.size())
+        {
+            return CLProgram();
+        }
+
+        std::vector<cl_device_id> devices;
+        if (!Devices(context, devices, log))
+        {
+            return CLProgram();
+        }
 
+        if (status)
+        {
+            status->resize(binaries.size());
+        }
+
+        cl_int error;
+        auto program = clCreateProgramWithBinary(context, (cl_uint)devices.size(), devices.data(), sizes.data(), (const unsigned char**)binaries.data(), status ? &(*status)[0] : nullptr, &error);
+
+        if (CL_SUCCESS != error)
+        {
+            log = "Failed to create program";
             return CLProgram();
         }
+        ONCLEANUP(program, [=]{ clReleaseProgram(program); });
 
         return CLProgram(program);
     }
@@ -328,5 +521,192 @@ public:
     }
 
 protected:
+    struct Build;
+
+    static void Pointers(const std::vector<std::vector<uint8_t>>& binaries, std::vector<const uint8_t*>& pointers, std::vector<size_t>& sizes)
+    {
+        for (auto& binary : binaries)
+        {
+            pointers.push_back(binary.data());
+            sizes.push_back(binary.size());
+        }
+    }
+
+    static void CL_CALLBACK Notify(cl_program, void* data);
+
+    static bool Devices(cl_context context, std::vector<cl_device_id>& devices, std::string& log)
+    {
+        size_t size;
+        cl_int error = clGetContextInfo(context, CL_CONTEXT_DEVICES, 0, nullptr, &size);
+        if (CL_SUCCESS != error)
+        {
+            log = "Failed to get context devices number";
+            return false;
+        }
+
+        devices.resize(size / sizeof(cl_device_id));
+        if (devices.empty())
+        {
+            log = "No associated devices to context";
+            return false;
+        }
+
+        error = clGetContextInfo(context, CL_CONTEXT_DEVICES, size, &devices[0], nullptr);
+        if (CL_SUCCESS != error)
+        {
+            log = "Failed to get context devices";
+            return false;
+        }
+        return true;
+    }
+
+    // Appends the log of the first device which failed to build 'program'.
+    static void BuildLog(cl_program program, const std::vector<cl_device_id>& devices, std::string& log)
+    {
+        for (auto device : devices)
+        {
+            cl_build_status status;
+            cl_int error = clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_STATUS, sizeof(status), &status, nullptr);
+            if (CL_SUCCESS != error)
+            {
+                log += "Failed to get program build status";
+                break;
+            }
+
+            if (CL_BUILD_ERROR == status)
+            {
+                size_t size;
+                error = clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &size);
+                if (CL_SUCCESS != error)
+                {
+                    log += "Failed to get program build log length";
+                    break;
+                }
+
+                std::string err;
+                err.resize(size);
+
+                error = clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, size, &err[0], nullptr);
+                if (CL_SUCCESS != error)
+                {
+                    log += "Failed to get program build log";
+                    break;
+                }
+
+                err.resize(err.size() - 1);
+                log += err;
+                break;
+            }
+        }
+    }
+
+protected:
+    struct KernelCache
+    {
+        KernelCache() : filled(false) {}
+
+        std::mutex lock;
+        std::unordered_map<std::string, CLKernel> kernels;
+        std::unordered_map<std::string, CLKernel> pristine;   // Clone() sources, never handed out
+        bool filled;
+    };
+
+protected:
+    cl_program program;
+    std::shared_ptr<KernelCache> kernels;
+};
+
+struct CLProgram::Build
+{
+    Build() : done(false), notified(false) {}
+
+    // Runs once, from the callback or from CreateAsync() if clBuildProgram failed right away.
+    void Finish()
+    {
+        if (this->done.exchange(true))
+        {
+            return;
+        }
+        ONCLEANUP(program, [this]{ clReleaseProgram(this->program); });
+
+        CLCounters::Global().Built(CLCounters::Now() - this->start);
+
+        for (auto device : this->devices)
+        {
+            cl_build_status status;
+            if (CL_SUCCESS != clGetProgramBuildInfo(this->program, device, CL_PROGRAM_BUILD_STATUS, sizeof(status), &status, nullptr) ||
+                CL_BUILD_SUCCESS != status)
+            {
+                *this->log = "Failed to build program\n";
+                BuildLog(this->program, this->devices, *this->log);
+                this->promise.set_value(CLProgram());
+                return;
+            }
+        }
+
+        this->promise.set_value(CLProgram(this->program));
+    }
+
+    std::promise<CLProgram> promise;
+    std::atomic<bool> done;
+    std::atomic<bool> notified;     // Notify() ran and freed the heap holder passed to the driver
     cl_program program;
-};
\ No newline at end of file
+    std::vector<cl_device_id> devices;
+    std::string* log;
+    uint64_t start;
+};
+
+inline void CL_CALLBACK CLProgram::Notify(cl_program, void* data)
+{
+    auto holder = (std::shared_ptr<Build>*)data;
+    auto build  = *holder;
+    delete holder;
+
+    build->notified = true;
+    build->Finish();
+}
+
+inline std::future<CLProgram> CLProgram::CreateAsync(cl_context context, const char* source, const char* options, std::string& log)
+{
+    std::promise<CLProgram> failed;
+    auto future = failed.get_future();
+
+    std::vector<cl_device_id> devices;
+    if (!Devices(context, devices, log))
+    {
+        failed.set_value(CLProgram());
+        return future;
+    }
+
+    cl_int error;
+    auto length = strlen(source);
+    auto program = clCreateProgramWithSource(context, 1, &source, &length, &error);
+    if (CL_SUCCESS != error)
+    {
+        log = "Failed to create program";
+        failed.set_value(CLProgram());
+        return future;
+    }
+
+    auto build = std::make_shared<Build>();
+    build->program = program;
+    build->devices = devices;
+    build->log     = &log;
+    build->start   = CLCounters::Now();
+    future = build->promise.get_future();
+
+    // The callback owns one reference to the build state and releases it.
+    auto data = new std::shared_ptr<Build>(build);
+    error = clBuildProgram(program, (cl_uint)devices.size(), devices.data(), options, Notify, data);
+    if (CL_SUCCESS != error)
+    {
+        // A build failing right away is over, the driver either called back already or never will.
+        if (CL_BUILD_PROGRAM_FAILURE != error || !build->notified)
+        {
+            delete data;
+        }
+        build->Finish();
+    }
+
+    return future;
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "CLProgram.h"
+#include "CLReactor.h"
+#include <string>
+#include <vector>
+
+// Builds many programs at once on a pool of host threads, so startup takes as long as the slowest build
+// instead of the sum of all of them. Each build can target all devices of its context or a subset, adding
+// the same source once per device spreads one program over several threads.
+class CLProgramBuilder
+{
+public:
+    CLProgramBuilder(size_t threads = 0) : reactor(threads)
+    {
+    }
+
+    // Queues a build of 'source' for 'devices', all devices of 'context' if empty, and returns its index.
+    size_t Add(cl_context context, const std::string& source, const std::string& options = std::string(),
+               const std::vector<cl_device_id>& devices = std::vector<cl_device_id>())
+    {
+        Job job;
+        job.context = context;
+        job.source  = source;
+        job.options = options;
+        job.devices = devices;
+
+        this->jobs.push_back(job);
+        return this->jobs.size() - 1;
+    }
+
+    // Builds every queued program not built yet and blocks until all are done. False if any failed, see
+    // Log() for the reason, failed programs are built again by the next call.
+    bool Build()
+    {
+        for (auto& job : this->jobs)
+        {
+            if (job.program)
+            {
+                continue;
+            }
+
+            auto target = &job;
+            this->reactor.Post([target]
+            {
+                auto& job = *target;
+                job.program = job.devices.empty() ? CLProgram::Create(job.context, job.source.c_str(), job.options.c_str(), job.log)
+                                                  : CLProgram::Create(job.context, job.devices, job.source.c_str(), job.options.c_str(), job.log);
+            });
+        }
+        this->reactor.Drain();
+
+        for (auto& job : this->jobs)
+        {
+            if (!job.program)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const CLProgram& Program(size_t index) const
+    {
+        return this->jobs[index].program;
+    }
+
+    const std::string& Log(size_t index) const
+    {
+        return this->jobs[index].log;
+    }
+
+    size_t Size() const
+    {
+        return this->jobs.size();
+    }
+
+protected:
+    struct Job
+    {
+        Job() : context(nullptr) {}
+
+        cl_context  context;
+        std::string source;
+        std::string options;
+        std::vector<cl_device_id> devices;
+        CLProgram   program;
+        std::string log;
+    };
+
+    std::vector<Job> jobs;
+    CLReactor reactor;
+};
\ No newline at end of file
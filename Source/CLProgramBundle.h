@@ -0,0 +1,481 @@
+#pragma once
+
+#include "CLDevice.h"
+#include "CLProgram.h"
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Program binaries of all devices in one file, mapped into memory on Open() so Load() passes them to the
+// driver without reading or copying. The header records the format version, a hash of the build options
+// and an optional caller key, every entry name and driver version of its device and a CRC-32 of its
+// binary. Load() checks all of them and the devices of the context before clBuildProgram runs, so a stale
+// or foreign bundle fails with a log instead of a driver error.
+//
+// Layout, in host byte order:
+//   Header                 "OCLB", Version, entry count, CRC-32 of header and entry table, options hash, key
+//   Entry[count]           binary offset and size, device name and driver offsets, CRC-32 of the binary
+//   strings and binaries   zero terminated strings, binaries aligned to Align bytes
+class CLProgramBundle
+{
+public:
+    static const uint32_t Version = 1;
+    static const uint64_t Align   = 64;
+
+    struct Header
+    {
+        char     Magic[4];
+        uint32_t Version;
+        uint32_t Count;
+        uint32_t Crc;           // Computed with this field zero
+        uint64_t Options;
+        uint64_t Key;
+    };
+
+    struct Entry
+    {
+        uint64_t Offset;
+        uint64_t Size;
+        uint64_t Name;          // Offsets of zero terminated strings
+        uint64_t Driver;
+        uint32_t Crc;
+        uint32_t Reserved;
+    };
+
+    CLProgramBundle() : data(nullptr), size(0), mapped(false)
+    {
+    }
+    CLProgramBundle(const CLProgramBundle&) = delete;
+    CLProgramBundle& operator=(const CLProgramBundle&) = delete;
+   ~CLProgramBundle()
+    {
+        this->Close();
+    }
+
+    // Maps the bundle at 'path' and checks its header, the entries are checked by Load().
+    bool Open(const std::string& path, std::string& log)
+    {
+        this->Close();
+
+#ifdef _WIN32
+        auto file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (INVALID_HANDLE_VALUE == file)
+        {
+            log = "Failed to open " + path;
+            return false;
+        }
+
+        LARGE_INTEGER length;
+        HANDLE mapping = nullptr;
+        if (GetFileSizeEx(file, &length) && length.QuadPart > 0)
+        {
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        }
+        CloseHandle(file);
+
+        // The view keeps the mapping alive.
+        void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (mapping)
+        {
+            CloseHandle(mapping);
+        }
+        if (!view)
+        {
+            log = "Failed to map " + path;
+            return false;
+        }
+        auto bytes = (size_t)length.QuadPart;
+#else
+        int file = open(path.c_str(), O_RDONLY);
+        if (file < 0)
+        {
+            log = "Failed to open " + path;
+            return false;
+        }
+
+        struct stat info;
+        void* view = MAP_FAILED;
+        if (0 == fstat(file, &info) && info.st_size > 0)
+        {
+            view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        }
+        close(file);
+
+        if (MAP_FAILED == view)
+        {
+            log = "Failed to map " + path;
+            return false;
+        }
+        auto bytes = (size_t)info.st_size;
+#endif
+
+        this->data   = (const uint8_t*)view;
+        this->size   = bytes;
+        this->mapped = true;
+
+        if (!this->Check(log))
+        {
+            this->Close();
+            return false;
+        }
+        return true;
+    }
+    // Bundle already in memory, e.g. embedded into the executable. 'data' has to outlive the bundle.
+    bool Open(const void* data, size_t size, std::string& log)
+    {
+        this->Close();
+
+        this->data = (const uint8_t*)data;
+        this->size = size;
+
+        if (!this->Check(log))
+        {
+            this->Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close()
+    {
+        if (this->mapped)
+        {
+#ifdef _WIN32
+            UnmapViewOfFile(this->data);
+#else
+            munmap((void*)this->data, this->size);
+#endif
+        }
+
+        this->data   = nullptr;
+        this->size   = 0;
+        this->mapped = false;
+    }
+
+    // True if the bundle holds one binary per device of 'context', in order, each built by a device of the
+    // same name and driver version, with options hashing to the same value.
+    bool Matches(cl_context context, const char* options, std::string& log) const
+    {
+        if (!*this)
+        {
+            log = "No bundle open";
+            return false;
+        }
+
+        if (this->Options() != Hash(options))
+        {
+            log = "Bundle built with other options";
+            return false;
+        }
+
+        std::vector<cl_device_id> devices;
+        if (!Devices(context, devices))
+        {
+            log = "Failed to get context devices";
+            return false;
+        }
+
+        if (devices.size() != this->Count())
+        {
+            log = "Bundle built for " + std::to_string(this->Count()) + " devices, context has " + std::to_string(devices.size());
+            return false;
+        }
+
+        for (size_t i = 0; i < devices.size(); i++)
+        {
+            CLDevice device(devices[i]);
+            if (device.Name() != this->Name(i) || device.Driver() != this->Driver(i))
+            {
+                log = "Bundle built for " + this->Name(i) + " " + this->Driver(i) + ", device is " + device.Name() + " " + device.Driver();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Program built from the mapped binaries once Matches() passed and every entry has a valid CRC.
+    CLProgram Load(cl_context context, const char* options, std::string& log, std::vector<cl_int>* status = nullptr) const
+    {
+        std::vector<const uint8_t*> binaries;
+        std::vector<size_t> sizes;
+        if (!this->Binaries(context, options, binaries, sizes, log))
+        {
+            return CLProgram();
+        }
+
+        return CLProgram::Load(context, binaries, sizes, log, status);
+    }
+    // Same for compiled objects or libraries, which go to CLProgram::Link() without a build.
+    CLProgram LoadObject(cl_context context, const char* options, std::string& log, std::vector<cl_int>* status = nullptr) const
+    {
+        std::vector<const uint8_t*> binaries;
+        std::vector<size_t> sizes;
+        if (!this->Binaries(context, options, binaries, sizes, log))
+        {
+            return CLProgram();
+        }
+
+        return CLProgram::LoadObject(context, binaries, sizes, log, status);
+    }
+
+    // Writes the binaries of 'program' with the identity of its devices. 'options' are the ones it was
+    // built with, 'key' is stored as is for the caller, see Key().
+    static bool Save(std::ostream& stream, const CLProgram& program, const char* options, uint64_t key = 0)
+    {
+        std::vector<std::vector<uint8_t>> binaries;
+        if (!program.GetBinary(binaries))
+        {
+            return false;
+        }
+
+        cl_uint count = 0;
+        if (CL_SUCCESS != clGetProgramInfo(program, CL_PROGRAM_NUM_DEVICES, sizeof(count), &count, nullptr) || count != binaries.size())
+        {
+            return false;
+        }
+
+        std::vector<cl_device_id> devices(count);
+        if (CL_SUCCESS != clGetProgramInfo(program, CL_PROGRAM_DEVICES, count * sizeof(cl_device_id), devices.data(), nullptr))
+        {
+            return false;
+        }
+
+        Header header = {};
+        memcpy(header.Magic, "OCLB", 4);
+        header.Version = Version;
+        header.Count   = count;
+        header.Options = Hash(options);
+        header.Key     = key;
+
+        std::vector<Entry> entries(count);
+        std::string strings;
+
+        uint64_t offset = sizeof(Header) + count * sizeof(Entry);
+        for (cl_uint i = 0; i < count; i++)
+        {
+            CLDevice device(devices[i]);
+
+            entries[i].Name = offset + strings.size();
+            strings += device.Name();
+            strings += '\0';
+
+            entries[i].Driver = offset + strings.size();
+            strings += device.Driver();
+            strings += '\0';
+        }
+        offset += strings.size();
+
+        for (cl_uint i = 0; i < count; i++)
+        {
+            offset = (offset + Align - 1) / Align * Align;
+
+            entries[i].Offset = offset;
+            entries[i].Size   = binaries[i].size();
+            entries[i].Crc    = Crc(binaries[i].data(), binaries[i].size());
+            offset += binaries[i].size();
+        }
+
+        header.Crc = Crc(&header, sizeof(header));
+        header.Crc = Crc(entries.data(), entries.size() * sizeof(Entry), header.Crc);
+
+        stream.write((const char*)&header, sizeof(header));
+        stream.write((const char*)entries.data(), entries.size() * sizeof(Entry));
+        stream.write(strings.data(), strings.size());
+
+        offset = sizeof(Header) + count * sizeof(Entry) + strings.size();
+        for (cl_uint i = 0; i < count; i++)
+        {
+            static const char padding[Align] = {};
+            stream.write(padding, entries[i].Offset - offset);
+            stream.write((const char*)binaries[i].data(), binaries[i].size());
+            offset = entries[i].Offset + entries[i].Size;
+        }
+
+        return !!stream;
+    }
+
+    size_t Count() const
+    {
+        return *this ? this->Head().Count : 0;
+    }
+    uint64_t Options() const
+    {
+        return *this ? this->Head().Options : 0;
+    }
+    uint64_t Key() const
+    {
+        return *this ? this->Head().Key : 0;
+    }
+
+    // Device name and driver version entry 'index' was built for.
+    std::string Name(size_t index) const
+    {
+        return (const char*)this->data + this->At(index).Name;
+    }
+    std::string Driver(size_t index) const
+    {
+        return (const char*)this->data + this->At(index).Driver;
+    }
+
+    operator bool() const
+    {
+        return !!this->data;
+    }
+
+    // FNV-1a of the build options, null and empty options hash alike.
+    static uint64_t Hash(const char* options)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (auto c = options ? options : ""; *c; c++)
+        {
+            hash ^= (uint8_t)*c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // CRC-32 as used by zip and PNG, 'crc' continues a previous one.
+    static uint32_t Crc(const void* data, size_t size, uint32_t crc = 0)
+    {
+        static const struct Table
+        {
+            Table()
+            {
+                for (uint32_t i = 0; i < 256; i++)
+                {
+                    uint32_t c = i;
+                    for (int k = 0; k < 8; k++)
+                    {
+                        c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                    }
+                    this->values[i] = c;
+                }
+            }
+            uint32_t values[256];
+        } table;
+
+        auto bytes = (const uint8_t*)data;
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++)
+        {
+            crc = table.values[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+protected:
+    const Header& Head() const
+    {
+        return *(const Header*)this->data;
+    }
+    const Entry& At(size_t index) const
+    {
+        return ((const Entry*)(this->data + sizeof(Header)))[index];
+    }
+
+    // Validates the header, the entry table and that every offset lies within the file.
+    bool Check(std::string& log) const
+    {
+        if (this->size < sizeof(Header) || 0 != memcmp(this->Head().Magic, "OCLB", 4))
+        {
+            log = "Not a program bundle";
+            return false;
+        }
+
+        auto header = this->Head();
+        if (Version != header.Version)
+        {
+            log = "Unsupported program bundle version " + std::to_string(header.Version);
+            return false;
+        }
+
+        if (!header.Count || (this->size - sizeof(Header)) / sizeof(Entry) < header.Count)
+        {
+            log = "Truncated program bundle";
+            return false;
+        }
+
+        auto crc = header.Crc;
+        header.Crc = 0;
+        header.Crc = Crc(&header, sizeof(header));
+        if (crc != Crc(this->data + sizeof(Header), header.Count * sizeof(Entry), header.Crc))
+        {
+            log = "Corrupt program bundle header";
+            return false;
+        }
+
+        for (size_t i = 0; i < header.Count; i++)
+        {
+            auto& entry = this->At(i);
+            if (entry.Offset > this->size || entry.Size > this->size - entry.Offset ||
+                !this->Terminated(entry.Name) || !this->Terminated(entry.Driver))
+            {
+                log = "Truncated program bundle";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool Terminated(uint64_t offset) const
+    {
+        return offset < this->size && memchr(this->data + offset, '\0', this->size - (size_t)offset);
+    }
+
+    bool Binaries(cl_context context, const char* options, std::vector<const uint8_t*>& binaries, std::vector<size_t>& sizes, std::string& log) const
+    {
+        if (!this->Matches(context, options, log))
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < this->Count(); i++)
+        {
+            auto& entry  = this->At(i);
+            auto  binary = this->data + entry.Offset;
+            if (entry.Crc != Crc(binary, (size_t)entry.Size))
+            {
+                log = "Corrupt binary for " + this->Name(i);
+                return false;
+            }
+
+            binaries.push_back(binary);
+            sizes.push_back((size_t)entry.Size);
+        }
+        return true;
+    }
+
+    static bool Devices(cl_context context, std::vector<cl_device_id>& devices)
+    {
+        size_t size = 0;
+        if (CL_SUCCESS != clGetContextInfo(context, CL_CONTEXT_DEVICES, 0, nullptr, &size) || !size)
+        {
+            return false;
+        }
+
+        devices.resize(size / sizeof(cl_device_id));
+        return CL_SUCCESS == clGetContextInfo(context, CL_CONTEXT_DEVICES, size, &devices[0], nullptr);
+    }
+
+protected:
+    const uint8_t* data;
+    size_t size;
+    bool   mapped;
+};
\ No newline at end of file
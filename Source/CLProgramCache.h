@@ -0,0 +1,477 @@
+#pragma once
+
+#include "CLDevice.h"
+#include "CLProgram.h"
+#include "CLProgramBundle.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Program binaries cached on disk across runs. Entries are keyed by a hash of the source, the files it
+// includes from the -I directories of the options, the options, and name, version and driver of every
+// device of the context, so a driver update starts a new entry. Entries are written to a temporary file
+// and renamed into place, and a lock file per entry keeps concurrent processes from building the same
+// program twice. Entries are CLProgramBundle files mapped on lookup, corrupt, foreign or rejected
+// binaries fall back to a source build which replaces the entry. Compile() caches objects for
+// CLProgram::Link() the same way.
+class CLProgramCache
+{
+public:
+    // 'dir' is created if missing, its parent has to exist.
+    CLProgramCache(const std::string& dir) : dir(dir)
+    {
+#ifdef _WIN32
+        _mkdir(dir.c_str());
+#else
+        mkdir(dir.c_str(), 0755);
+#endif
+    }
+
+    // Program for all devices of 'context', loaded from the cache or built from source and stored. 'hit'
+    // tells which of the two happened.
+    CLProgram Create(cl_context context, const char* source, const char* options, std::string& log, bool* hit = nullptr) const
+    {
+        return this->Lookup(this->Key(context, source, options), options, log, hit,
+                            [&](const CLProgramBundle& bundle, std::string& error, std::vector<cl_int>* status){ return bundle.Load(context, options, error, status); },
+                            [&]{ return CLProgram::Create(context, source, options, log); });
+    }
+    CLProgram Create(cl_context context, std::istream& source, const char* options, std::string& log, bool* hit = nullptr) const
+    {
+        return this->Create(context, std::string(std::istreambuf_iterator<char>(source), std::istreambuf_iterator<char>()).c_str(), options, log, hit);
+    }
+
+    // Compiled object of 'source' for CLProgram::Link(), cached like Create() with 'headers' as part of the key.
+    CLProgram Compile(cl_context context, const char* source, const std::map<std::string, std::string>& headers, const char* options,
+                      std::string& log, bool* hit = nullptr) const
+    {
+        return this->Lookup(this->Key(context, source, headers, options), options, log, hit,
+                            [&](const CLProgramBundle& bundle, std::string& error, std::vector<cl_int>* status){ return bundle.LoadObject(context, options, error, status); },
+                            [&]{ return CLProgram::Compile(context, source, headers, options, log); });
+    }
+
+    // File holding the entry of 'source' built with 'options' for the devices of 'context'.
+    std::string Path(cl_context context, const char* source, const char* options) const
+    {
+        return this->Path(this->Key(context, source, options));
+    }
+    std::string Path(cl_context context, const char* source, const std::map<std::string, std::string>& headers, const char* options) const
+    {
+        return this->Path(this->Key(context, source, headers, options));
+    }
+
+    // Build options recorded with Remember() for 'source' on the devices of 'context', e.g. the winner of a
+    // CLProgramTuner run. 'tag' keeps records of unrelated choices apart.
+    bool Recall(cl_context context, const char* source, const std::string& tag, std::string& options) const
+    {
+        auto key = this->Key(context, source, tag);
+        if (!key)
+        {
+            return false;
+        }
+
+        std::ifstream file(this->Path(key, "opt"), std::ios::binary);
+        if (!file)
+        {
+            return false;
+        }
+
+        uint64_t stored = 0;
+        file.read((char*)&stored, sizeof(stored));
+        if (!file || key != stored)
+        {
+            return false;
+        }
+
+        options.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+    bool Remember(cl_context context, const char* source, const std::string& tag, const std::string& options) const
+    {
+        auto key = this->Key(context, source, tag);
+        if (!key)
+        {
+            return false;
+        }
+
+        // Same lock as Lookup(), writers of one key would otherwise share the temporary file.
+        auto path = this->Path(key, "opt");
+        Lock lock(path + ".lock");
+
+        return Replace(path, [&](std::ostream& file)
+        {
+            file.write((const char*)&key, sizeof(key));
+            file.write(options.data(), options.size());
+            return true;
+        });
+    }
+
+    bool Forget(cl_context context, const char* source, const std::string& tag) const
+    {
+        auto key = this->Key(context, source, tag);
+        if (!key)
+        {
+            return false;
+        }
+
+        auto path = this->Path(key, "opt");
+        Lock lock(path + ".lock");
+
+        return 0 == std::remove(path.c_str());
+    }
+
+    const std::string& Directory() const
+    {
+        return this->dir;
+    }
+
+protected:
+    // Holds an exclusive lock on 'path' until destroyed. Locking failures are not fatal, the rename keeps
+    // entries consistent and only the duplicate build is lost.
+    class Lock
+    {
+    public:
+        Lock(const std::string& path)
+        {
+#ifdef _WIN32
+            this->file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (INVALID_HANDLE_VALUE != this->file)
+            {
+                OVERLAPPED overlapped = {};
+                LockFileEx(this->file, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped);
+            }
+#else
+            this->file = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+            if (this->file >= 0)
+            {
+                while (0 != flock(this->file, LOCK_EX) && EINTR == errno)
+                {
+                }
+            }
+#endif
+        }
+        Lock(const Lock&) = delete;
+        Lock& operator=(const Lock&) = delete;
+       ~Lock()
+        {
+#ifdef _WIN32
+            if (INVALID_HANDLE_VALUE != this->file)
+            {
+                OVERLAPPED overlapped = {};
+                UnlockFileEx(this->file, 0, 1, 0, &overlapped);
+                CloseHandle(this->file);
+            }
+#else
+            if (this->file >= 0)
+            {
+                flock(this->file, LOCK_UN);
+                close(this->file);
+            }
+#endif
+        }
+
+    protected:
+#ifdef _WIN32
+        HANDLE file;
+#else
+        int file;
+#endif
+    };
+
+    // FNV-1a, stable across platforms and runs.
+    static uint64_t Checksum(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+    {
+        auto bytes = (const uint8_t*)data;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+    static uint64_t Hash(const std::string& text, uint64_t hash)
+    {
+        // The terminator keeps ("ab", "c") and ("a", "bc") apart.
+        return Checksum(text.c_str(), text.size() + 1, hash);
+    }
+
+    static std::vector<cl_device_id> Devices(cl_context context)
+    {
+        size_t size = 0;
+        if (CL_SUCCESS != clGetContextInfo(context, CL_CONTEXT_DEVICES, 0, nullptr, &size) || !size)
+        {
+            return std::vector<cl_device_id>();
+        }
+
+        std::vector<cl_device_id> devices(size / sizeof(cl_device_id));
+        if (CL_SUCCESS != clGetContextInfo(context, CL_CONTEXT_DEVICES, size, &devices[0], nullptr))
+        {
+            return std::vector<cl_device_id>();
+        }
+        return devices;
+    }
+
+    // Zero if the devices of 'context' could not be queried.
+    uint64_t Key(cl_context context, const char* source, const char* options) const
+    {
+        auto devices = Devices(context);
+        if (devices.empty())
+        {
+            return 0;
+        }
+
+        options = options ? options : "";
+
+        auto hash = Sources(source, options);
+        hash = Hash(options, hash);
+        for (auto id : devices)
+        {
+            CLDevice device(id);
+            hash = Hash(device.Name(), hash);
+            hash = Hash(device.Version(), hash);
+            hash = Hash(device.Driver(), hash);
+        }
+        return hash ? hash : 1;
+    }
+
+    // Compiled objects get keys of their own.
+    uint64_t Key(cl_context context, const char* source, const std::map<std::string, std::string>& headers, const char* options) const
+    {
+        auto hash = this->Key(context, source, options);
+        if (!hash)
+        {
+            return 0;
+        }
+
+        hash = Hash("-compile", hash);
+        for (auto& header : headers)
+        {
+            hash = Hash(header.first, hash);
+            hash = Hash(header.second, hash);
+        }
+        return hash ? hash : 1;
+    }
+
+    // Records get keys of their own.
+    uint64_t Key(cl_context context, const char* source, const std::string& tag) const
+    {
+        auto hash = this->Key(context, source, "");
+        if (!hash)
+        {
+            return 0;
+        }
+
+        hash = Hash("-record", hash);
+        hash = Hash(tag, hash);
+        return hash ? hash : 1;
+    }
+
+    template<typename Load, typename Build>
+    CLProgram Lookup(uint64_t key, const char* options, std::string& log, bool* hit, Load load, Build build) const
+    {
+        if (hit)
+        {
+            *hit = false;
+        }
+
+        if (!key)
+        {
+            log = "Failed to get context devices";
+            return CLProgram();
+        }
+
+        auto path = this->Path(key);
+
+        Lock lock(path + ".lock");
+
+        {
+            std::string error;
+            std::vector<cl_int> status;
+
+            CLProgramBundle bundle;
+            if (bundle.Open(path, error) && key == bundle.Key())
+            {
+                auto program = load(bundle, error, &status);
+                if (program && Succeeded(status))
+                {
+                    if (hit)
+                    {
+                        *hit = true;
+                    }
+                    return program;
+                }
+            }
+        }
+
+        // The bundle is unmapped by now, Windows cannot replace a mapped file.
+        auto program = build();
+        if (program)
+        {
+            Write(path, key, program, options);
+        }
+        return program;
+    }
+
+    std::string Path(uint64_t key, const char* extension = "bin") const
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.%s", (unsigned long long)key, extension);
+        return this->dir + "/" + name;
+    }
+
+    // Hash of 'source' and, recursively, of every file it includes that is found in the -I directories of
+    // 'options' or the working directory.
+    static uint64_t Sources(const std::string& source, const std::string& options)
+    {
+        std::vector<std::string> dirs;
+
+        std::istringstream tokens(options);
+        std::string token;
+        while (tokens >> token)
+        {
+            if (0 == token.compare(0, 2, "-I"))
+            {
+                if (token.size() > 2)
+                {
+                    dirs.push_back(token.substr(2));
+                }
+                else if (tokens >> token)
+                {
+                    dirs.push_back(token);
+                }
+            }
+        }
+        dirs.push_back(".");
+
+        std::set<std::string> seen;
+        return Includes(source, dirs, seen, Hash(source, 14695981039346656037ull));
+    }
+    static uint64_t Includes(const std::string& source, const std::vector<std::string>& dirs, std::set<std::string>& seen, uint64_t hash)
+    {
+        std::istringstream lines(source);
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            auto pos = line.find_first_not_of(" \t");
+            if (std::string::npos == pos || '#' != line[pos])
+            {
+                continue;
+            }
+
+            pos = line.find_first_not_of(" \t", pos + 1);
+            if (std::string::npos == pos || 0 != line.compare(pos, 7, "include"))
+            {
+                continue;
+            }
+
+            auto open = line.find_first_of("\"<", pos + 7);
+            if (std::string::npos == open)
+            {
+                continue;
+            }
+            auto close = line.find('"' == line[open] ? '"' : '>', open + 1);
+            if (std::string::npos == close)
+            {
+                continue;
+            }
+
+            auto name = line.substr(open + 1, close - open - 1);
+            for (auto& dir : dirs)
+            {
+                auto path = dir + "/" + name;
+
+                std::ifstream file(path, std::ios::binary);
+                if (!file)
+                {
+                    continue;
+                }
+
+                if (seen.insert(path).second)
+                {
+                    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+                    hash = Hash(name, hash);
+                    hash = Hash(text, hash);
+                    hash = Includes(text, dirs, seen, hash);
+                }
+                break;
+            }
+        }
+        return hash;
+    }
+
+    static bool Succeeded(const std::vector<cl_int>& status)
+    {
+        for (auto s : status)
+        {
+            if (CL_SUCCESS != s)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool Write(const std::string& path, uint64_t key, const CLProgram& program, const char* options)
+    {
+        return Replace(path, [&](std::ostream& file){ return CLProgramBundle::Save(file, program, options, key); });
+    }
+
+    // Writes a temporary file through 'write' and renames it over 'path'.
+    template<typename Writer>
+    static bool Replace(const std::string& path, Writer write)
+    {
+#ifdef _WIN32
+        auto temp = path + "." + std::to_string(GetCurrentProcessId()) + ".tmp";
+#else
+        auto temp = path + "." + std::to_string(getpid()) + ".tmp";
+#endif
+        {
+            std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+            auto written = write(file);
+            file.close();
+
+            if (!written || !file)
+            {
+                std::remove(temp.c_str());
+                return false;
+            }
+        }
+
+#ifdef _WIN32
+        if (!MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+#else
+        if (0 != std::rename(temp.c_str(), path.c_str()))
+#endif
+        {
+            std::remove(temp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+protected:
+    std::string dir;
+};
\ No newline at end of file
@@ -0,0 +1,230 @@
+#pragma once
+
+#include "CLCounters.h"
+#include "CLProgram.h"
+#include "CLProgramCache.h"
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Picks the fastest build options for a program. Every candidate set is appended to the base options, built,
+// and handed to a benchmark which runs the kernels of interest on representative inputs and blocks until
+// they finished. The first run warms up and may reject the candidate, e.g. when its outputs are not
+// Within() the tolerance of a reference, the best of the following runs counts. With a CLProgramCache the
+// builds are cached and the winner is recorded for the devices of the context, later runs build it right
+// away without benchmarking.
+class CLProgramTuner
+{
+public:
+    // Runs the kernels of 'program', false rejects it.
+    typedef std::function<bool(const CLProgram& program)> Benchmark;
+
+    struct Result
+    {
+        std::string Options;    // Candidate set without the base options
+        uint64_t    Time;       // Best run in ns, zero if rejected
+        std::string Log;        // Why the candidate was rejected
+    };
+
+    CLProgramTuner(cl_context context, const std::string& source, const std::string& options = std::string(),
+                   const std::shared_ptr<CLProgramCache>& cache = nullptr)
+        : context(context), source(source), options(options), cache(cache), runs(5)
+    {
+        // The base options alone are always a candidate.
+        this->candidates.push_back(std::string());
+    }
+
+    // Adds a set of options to try, e.g. "-cl-mad-enable -cl-no-signed-zeros" or CLDefines::Options().
+    CLProgramTuner& Candidate(const std::string& options)
+    {
+        this->candidates.push_back(options);
+        return *this;
+    }
+
+    // Math relaxations worth trying for most floating point kernels.
+    CLProgramTuner& Relaxations()
+    {
+        this->Candidate("-cl-mad-enable");
+        this->Candidate("-cl-no-signed-zeros");
+        this->Candidate("-cl-mad-enable -cl-no-signed-zeros");
+        this->Candidate("-cl-fast-relaxed-math");
+        return *this;
+    }
+
+    // Timed runs per candidate after the warm up.
+    void Runs(size_t runs)
+    {
+        this->runs = runs ? runs : 1;
+    }
+
+    // Program built with the winning options, empty if no candidate passed, see Results().
+    CLProgram Tune(const Benchmark& benchmark, std::string& log)
+    {
+        this->results.clear();
+        this->winner.clear();
+
+        auto tag = this->Tag();
+
+        std::string recorded;
+        if (this->cache && this->cache->Recall(this->context, this->source.c_str(), tag, recorded))
+        {
+            auto program = this->Build(recorded, log);
+            if (program)
+            {
+                this->winner = recorded;
+                return program;
+            }
+        }
+
+        CLProgram best;
+        uint64_t fastest = UINT64_MAX;
+
+        for (auto& candidate : this->candidates)
+        {
+            Result result;
+            result.Options = candidate;
+            result.Time    = 0;
+
+            auto program = this->Build(candidate, result.Log);
+            if (program)
+            {
+                result.Time = this->Measure(program, benchmark, result.Log);
+            }
+
+            if (result.Time && result.Time < fastest)
+            {
+                fastest = result.Time;
+                best    = program;
+                this->winner = candidate;
+            }
+            this->results.push_back(result);
+        }
+
+        if (!best)
+        {
+            log = "No candidate passed the benchmark";
+            return CLProgram();
+        }
+
+        if (this->cache)
+        {
+            this->cache->Remember(this->context, this->source.c_str(), tag, this->winner);
+        }
+        return best;
+    }
+
+    // Drops the recorded winner so the next Tune() benchmarks again.
+    void Forget()
+    {
+        if (this->cache)
+        {
+            this->cache->Forget(this->context, this->source.c_str(), this->Tag());
+        }
+    }
+
+    // Winning candidate of the last Tune(), without the base options.
+    const std::string& Winner() const
+    {
+        return this->winner;
+    }
+
+    // Base and winning options together, as the program was built.
+    std::string Options() const
+    {
+        return this->Join(this->winner);
+    }
+
+    // Outcome of every candidate, in the order added. Empty if the winner was recalled from the cache.
+    const std::vector<Result>& Results() const
+    {
+        return this->results;
+    }
+
+    // True if every value is within 'tolerance' of the reference, relative to its magnitude above 1.
+    template<typename T>
+    static bool Within(const T* values, const T* reference, size_t count, double tolerance)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            auto expected = (double)reference[i];
+            auto scale    = std::fabs(expected) > 1.0 ? std::fabs(expected) : 1.0;
+            if (!(std::fabs((double)values[i] - expected) <= tolerance * scale))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    template<typename T>
+    static bool Within(const std::vector<T>& values, const std::vector<T>& reference, double tolerance)
+    {
+        return values.size() == reference.size() && Within(values.data(), reference.data(), values.size(), tolerance);
+    }
+
+protected:
+    std::string Join(const std::string& candidate) const
+    {
+        if (candidate.empty() || this->options.empty())
+        {
+            return this->options + candidate;
+        }
+        return this->options + " " + candidate;
+    }
+
+    // Identifies the base options and candidate list the recorded winner was chosen from.
+    std::string Tag() const
+    {
+        std::string tag = "-tune " + this->options;
+        for (auto& candidate : this->candidates)
+        {
+            tag += '\n' + candidate;
+        }
+        return tag;
+    }
+
+    CLProgram Build(const std::string& candidate, std::string& log) const
+    {
+        auto options = this->Join(candidate);
+        return this->cache ? this->cache->Create(this->context, this->source.c_str(), options.c_str(), log)
+                           : CLProgram::Create(this->context, this->source.c_str(), options.c_str(), log);
+    }
+
+    // Best time of the timed runs, zero if the benchmark rejected the program.
+    uint64_t Measure(const CLProgram& program, const Benchmark& benchmark, std::string& log) const
+    {
+        if (!benchmark(program))
+        {
+            log = "Rejected by the benchmark";
+            return 0;
+        }
+
+        uint64_t best = UINT64_MAX;
+        for (size_t i = 0; i < this->runs; i++)
+        {
+            auto start = CLCounters::Now();
+            if (!benchmark(program))
+            {
+                log = "Rejected by the benchmark";
+                return 0;
+            }
+
+            auto time = CLCounters::Now() - start;
+            best = time < best ? time : best;
+        }
+        return best ? best : 1;
+    }
+
+protected:
+    cl_context  context;
+    std::string source;
+    std::string options;
+    std::shared_ptr<CLProgramCache> cache;
+    std::vector<std::string> candidates;
+    size_t      runs;
+
+    std::vector<Result> results;
+    std::string winner;
+};
\ No newline at end of file
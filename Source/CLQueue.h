@@ -1,12 +1,26 @@
 #pragma once
 
 #include "CLCommon.h"
+#include "CLEvent.h"
+#include "CLTrace.h"
+#include "CLWaits.h"
 #include <CL/cl.h>
 
+struct CLQueueOptions
+{
+    CLQueueOptions() : Profiling(false), OutOfOrder(false), OnDevice(false), OnDeviceDefault(false), Size(0) {}
+
+    bool    Profiling;
+    bool    OutOfOrder;
+    bool    OnDevice;           // Device side queue, implies out-of-order execution.
+    bool    OnDeviceDefault;    // Also makes it the default device queue, implies on-device.
+    cl_uint Size;               // Size of on-device queue in bytes, 0 for device preferred.
+};
+
 class CLQueue
 {
 public:
-    CLQueue() : queue(nullptr)
+    CLQueue() : queue(nullptr), err(0)
     {
     }
     CLQueue(cl_command_queue queue) : CLQueue()
@@ -20,7 +34,7 @@ public:
     {
         *this = std::move(other);
     }
-    CLQueue(const CLQueue& other)
+    CLQueue(const CLQueue& other) : CLQueue()
     {
         *this = other;
     }
@@ -37,6 +51,10 @@ public:
         auto queue = this->queue;
         this->queue = other.queue;
         other.queue = queue;
+
+        auto err = this->err;
+        this->err = other.err;
+        other.err = err;
         return *this;
     }
     CLQueue& operator=(const CLQueue& other)
@@ -52,12 +70,76 @@ public:
         }
 
         this->queue = other.queue;
+        this->err   = other.err;
         return *this;
     }
 
-    void Finish()
+    // Blocks until every command enqueued so far completed.
+    cl_int Finish() const
+    {
+        this->err = clFinish(this->queue);
+        return this->err;
+    }
+
+    // Submits enqueued commands to the device without waiting for them.
+    cl_int Flush() const
+    {
+        this->err = clFlush(this->queue);
+        return this->err;
+    }
+
+    // Event completing once 'waits' completed, or every command enqueued so far if 'waits' is empty.
+    // Later commands are not held back, wait on the marker where a stage has to be fenced.
+    CLEvent Marker(const CLWaits& waits = CLWaits()) const
     {
-        clFinish(this->queue);
+        CLWaitList events(waits);
+
+        CLProbe probe(this->queue, CLOp::Marker);
+
+        cl_event event;
+        this->err = clEnqueueMarkerWithWaitList(this->queue, events.Size(), events.Data(), &event);
+        return this->Take(event, probe);
+    }
+
+    // Like Marker(), but commands enqueued afterwards also wait for it, which orders out-of-order queues.
+    CLEvent Barrier(const CLWaits& waits = CLWaits()) const
+    {
+        CLWaitList events(waits);
+
+        CLProbe probe(this->queue, CLOp::Barrier);
+
+        cl_event event;
+        this->err = clEnqueueBarrierWithWaitList(this->queue, events.Size(), events.Data(), &event);
+        return this->Take(event, probe);
+    }
+
+    // Records commands enqueued on this queue into 'tracer', create the queue with profiling enabled to get
+    // the device track as well.
+    void Trace(const CLTracer& tracer) const
+    {
+        tracer.Attach(this->queue);
+    }
+
+    cl_int Error() const
+    {
+        return this->err;
+    }
+
+    cl_command_queue_properties Properties() const
+    {
+        cl_command_queue_properties properties = 0;
+        clGetCommandQueueInfo(this->queue, CL_QUEUE_PROPERTIES, sizeof(properties), &properties, nullptr);
+        return properties;
+    }
+
+    bool Profiling() const
+    {
+        return !!(CL_QUEUE_PROFILING_ENABLE & this->Properties());
+    }
+
+    bool OutOfOrder() const
+    {
+        return !!(CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE & this->Properties());
     }
 
     operator cl_command_queue() const
@@ -65,7 +147,7 @@ public:
         return this->queue;
     }
 
-    static CLQueue Create(cl_context context, cl_device_id device = nullptr)
+    static CLQueue Create(cl_context context, cl_device_id device = nullptr, const CLQueueOptions& options = CLQueueOptions())
     {
         if (!device)
         {
@@ -83,16 +165,72 @@ public:
             }
         }
 
+        cl_command_queue_properties flags = 0;
+        if (options.Profiling)
+        {
+            flags |= CL_QUEUE_PROFILING_ENABLE;
+        }
+        if (options.OutOfOrder)
+        {
+            flags |= CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
+        }
+
         cl_int err;
 #if CL_TARGET_OPENCL_VERSION >= 200
-        auto queue = clCreateCommandQueueWithProperties(context, device, nullptr, &err);
+        if (options.OnDevice || options.OnDeviceDefault)
+        {
+            flags |= CL_QUEUE_ON_DEVICE | CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
+        }
+        if (options.OnDeviceDefault)
+        {
+            flags |= CL_QUEUE_ON_DEVICE_DEFAULT;
+        }
+
+        cl_queue_properties properties[5] = { 0 };
+        size_t count = 0;
+
+        if (flags)
+        {
+            properties[count++] = CL_QUEUE_PROPERTIES;
+            properties[count++] = flags;
+        }
+
+        if ((CL_QUEUE_ON_DEVICE & flags) && options.Size)
+        {
+            properties[count++] = CL_QUEUE_SIZE;
+            properties[count++] = options.Size;
+        }
+
+        auto queue = clCreateCommandQueueWithProperties(context, device, count ? properties : nullptr, &err);
 #else
-        auto queue = clCreateCommandQueue(context, device, 0, &err);
+        if (options.OnDevice || options.OnDeviceDefault)
+        {
+            return CLQueue(nullptr);
+        }
+
+        auto queue = clCreateCommandQueue(context, device, flags, &err);
 #endif
         ONCLEANUP(queue, [=]{ if (queue) clReleaseCommandQueue(queue); });
         return CLQueue(queue);
     }
 
+protected:
+    CLEvent Take(cl_event event, const CLProbe& probe) const
+    {
+        if (CL_SUCCESS != this->err)
+        {
+            return CLEvent();
+        }
+
+        probe.Done(event);
+
+        CLEvent evt(event);
+        clReleaseEvent(event);
+        return evt;
+    }
+
 protected:
     cl_command_queue queue;
+
+    mutable cl_int err;
 };
\ No newline at end of file
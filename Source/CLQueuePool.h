@@ -0,0 +1,156 @@
+#pragma once
+
+#include "CLFlags.h"
+#include "CLQueue.h"
+#include <atomic>
+#include <utility>
+#include <vector>
+
+// Dedicated upload, download and compute queues on one device, so transfers can overlap kernels on
+// hardware with independent copy engines. Writes go to Upload(), reads to Download(), kernels and device
+// side copies to Compute(); lanes of the same type are handed out round-robin. Commands on different
+// queues are only ordered through events, pass the previous command as a wait or enable hazard tracking
+// on the memory objects involved. Getters may be called from any thread.
+class CLQueuePool
+{
+public:
+    CLQueuePool()
+    {
+        for (auto& next : this->next)
+        {
+            next.store(0, std::memory_order_relaxed);
+        }
+    }
+    CLQueuePool(CLQueuePool&& other) : CLQueuePool()
+    {
+        *this = std::move(other);
+    }
+    CLQueuePool(const CLQueuePool&) = delete;
+
+    CLQueuePool& operator=(CLQueuePool&& other)
+    {
+        this->uploads.swap(other.uploads);
+        this->downloads.swap(other.downloads);
+        this->computes.swap(other.computes);
+
+        for (size_t i = 0; i < 3; i++)
+        {
+            auto next = this->next[i].load(std::memory_order_relaxed);
+            this->next[i].store(other.next[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            other.next[i].store(next, std::memory_order_relaxed);
+        }
+        return *this;
+    }
+    CLQueuePool& operator=(const CLQueuePool&) = delete;
+
+    // Host to device transfers.
+    const CLQueue& Upload() const
+    {
+        return this->Lane(this->uploads.empty() ? this->computes : this->uploads, 0);
+    }
+    // Device to host transfers.
+    const CLQueue& Download() const
+    {
+        return this->Lane(this->downloads.empty() ? this->computes : this->downloads, 1);
+    }
+    // Kernels and device side copies.
+    const CLQueue& Compute() const
+    {
+        return this->Lane(this->computes, 2);
+    }
+    // Lane for mapping, read-only maps go down and anything writable goes up.
+    const CLQueue& Map(uint32_t flags) const
+    {
+        return CLFlags::WO & flags ? this->Upload() : this->Download();
+    }
+
+    void Flush() const
+    {
+        for (auto lanes : { &this->uploads, &this->downloads, &this->computes })
+        {
+            for (auto& queue : *lanes)
+            {
+                clFlush(queue);
+            }
+        }
+    }
+
+    void Finish() const
+    {
+        this->Flush();
+
+        for (auto lanes : { &this->uploads, &this->downloads, &this->computes })
+        {
+            for (auto& queue : *lanes)
+            {
+                clFinish(queue);
+            }
+        }
+    }
+
+    size_t Uploads() const
+    {
+        return this->uploads.size();
+    }
+    size_t Downloads() const
+    {
+        return this->downloads.size();
+    }
+    size_t Computes() const
+    {
+        return this->computes.size();
+    }
+
+    operator bool() const
+    {
+        return !this->computes.empty();
+    }
+
+    // Upload or download lanes may be 0, their operations then go to the compute lanes.
+    static CLQueuePool Create(cl_context context, cl_device_id device = nullptr, size_t uploads = 1, size_t downloads = 1, size_t computes = 1,
+                              const CLQueueOptions& options = CLQueueOptions())
+    {
+        CLQueuePool pool;
+        if (!computes)
+        {
+            return pool;
+        }
+
+        std::vector<CLQueue>* lanes[] = { &pool.uploads, &pool.downloads, &pool.computes };
+        size_t counts[] = { uploads, downloads, computes };
+
+        for (size_t i = 0; i < 3; i++)
+        {
+            for (size_t j = 0; j < counts[i]; j++)
+            {
+                auto queue = CLQueue::Create(context, device, options);
+                if (!queue)
+                {
+                    return CLQueuePool();
+                }
+                lanes[i]->push_back(std::move(queue));
+            }
+        }
+
+        return pool;
+    }
+
+protected:
+    // Empty queue if the pool is.
+    const CLQueue& Lane(const std::vector<CLQueue>& lanes, size_t type) const
+    {
+        static const CLQueue none;
+        if (lanes.empty())
+        {
+            return none;
+        }
+        return lanes[this->next[type].fetch_add(1, std::memory_order_relaxed) % lanes.size()];
+    }
+
+protected:
+    std::vector<CLQueue> uploads;
+    std::vector<CLQueue> downloads;
+    std::vector<CLQueue> computes;
+
+    mutable std::atomic<size_t> next[3];
+};
\ No newline at end of file
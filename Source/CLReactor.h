@@ -0,0 +1,203 @@
+#pragma once
+
+#include "CLEvent.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Dispatches event completions onto a fixed pool of host threads. Nothing waits in clWaitForEvents, any
+// number of commands can be outstanding, and follow-up host work starts as soon as the device finishes.
+// At most 'capacity' handlers are pending at once, Post() blocks until one finished when more arrive, except
+// on pool threads which could otherwise wait for themselves. A handler that throws is counted in Failures()
+// and the pool thread carries on.
+class CLReactor
+{
+public:
+    CLReactor(size_t threads = 0, size_t capacity = 4096) : pending(0), capacity(capacity ? capacity : 1), failures(0), stop(false)
+    {
+        if (!threads)
+        {
+            threads = std::thread::hardware_concurrency();
+        }
+
+        for (size_t i = 0; i < (threads ? threads : 1); i++)
+        {
+            this->workers.push_back(std::thread([this]{ this->Run(); }));
+        }
+    }
+    CLReactor(const CLReactor&) = delete;
+    virtual ~CLReactor()
+    {
+        this->Drain();
+
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            this->stop = true;
+        }
+        this->ready.notify_all();
+
+        for (auto& worker : this->workers)
+        {
+            worker.join();
+        }
+    }
+
+    CLReactor& operator=(const CLReactor&) = delete;
+
+    // Runs 'handler' on a pool thread with CL_COMPLETE or the negative error status of 'event'.
+    cl_int Post(cl_event event, const std::function<void(cl_int)>& handler)
+    {
+        this->Reserve();
+
+        auto error = CLEvent(event).OnComplete([this, handler](cl_int status){ this->Push([handler, status]{ handler(status); }); });
+        if (CL_SUCCESS != error)
+        {
+            this->Done();
+        }
+
+        return error;
+    }
+
+    // Runs 'task' on a pool thread right away.
+    void Post(const std::function<void()>& task)
+    {
+        this->Reserve();
+
+        this->Push(task);
+    }
+
+    // Blocks until every posted handler has run.
+    void Drain()
+    {
+        std::unique_lock<std::mutex> guard(this->lock);
+        this->drained.wait(guard, [this]{ return 0 == this->pending; });
+    }
+
+    size_t Pending() const
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        return this->pending;
+    }
+
+    size_t Threads() const
+    {
+        return this->workers.size();
+    }
+
+    // Handlers that threw, and the message of the last one.
+    size_t Failures() const
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        return this->failures;
+    }
+    std::string Failure() const
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        return this->failure;
+    }
+
+protected:
+    void Reserve()
+    {
+        std::unique_lock<std::mutex> guard(this->lock);
+        if (!this->Worker())
+        {
+            this->drained.wait(guard, [this]{ return this->pending < this->capacity; });
+        }
+        this->pending++;
+    }
+
+    bool Worker() const
+    {
+        auto id = std::this_thread::get_id();
+        for (auto& worker : this->workers)
+        {
+            if (worker.get_id() == id)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Called from OpenCL callback threads, must never block for long.
+    void Push(const std::function<void()>& task)
+    {
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            this->tasks.push_back(task);
+        }
+        this->ready.notify_one();
+    }
+
+    void Done()
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        if (0 == --this->pending || this->pending + 1 == this->capacity)
+        {
+            this->drained.notify_all();
+        }
+    }
+
+    void Run()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> guard(this->lock);
+                this->ready.wait(guard, [this]{ return this->stop || !this->tasks.empty(); });
+
+                if (this->tasks.empty())
+                {
+                    return;
+                }
+
+                task = std::move(this->tasks.front());
+                this->tasks.pop_front();
+            }
+
+            if (task)
+            {
+                try
+                {
+                    task();
+                }
+                catch (const std::exception& e)
+                {
+                    this->Fail(e.what());
+                }
+                catch (...)
+                {
+                    this->Fail("Unknown exception");
+                }
+            }
+            this->Done();
+        }
+    }
+
+    void Fail(const std::string& message)
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->failures++;
+        this->failure = message;
+    }
+
+protected:
+    mutable std::mutex lock;
+    std::condition_variable ready;
+    std::condition_variable drained;
+    std::deque<std::function<void()>> tasks;
+    std::vector<std::thread> workers;
+
+    size_t pending;
+    size_t capacity;
+    size_t failures;
+    std::string failure;
+    bool   stop;
+};
\ No newline at end of file
@@ -0,0 +1,344 @@
+#pragma once
+
+#include "CLCounters.h"
+#include "CLEvent.h"
+#include "CLLatency.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Records the commands enqueued on attached queues and writes them as Chrome trace_event JSON, viewable in
+// chrome://tracing or Perfetto. The host track shows the time each enqueue call took per thread, the device
+// track the start to end time of each command per queue. Device timestamps need queues created with
+// profiling enabled and are aligned to the host clock through the queued time of the first command.
+class CLTracer
+{
+protected:
+    struct Record
+    {
+        CLOp::Type  type;
+        std::string name;
+        size_t      bytes;
+        size_t      global;
+        size_t      thread;
+        cl_command_queue queue;
+        long long   submit;     // Host steady clock, nanoseconds
+        long long   returned;
+        bool        complete;
+        CLEventProfile profile;
+    };
+
+public:
+    struct State : std::enable_shared_from_this<State>
+    {
+        State() : origin(CLTracer::Now()), generation(0) {}
+       ~State()
+        {
+            std::lock_guard<std::mutex> guard(Registry().lock);
+
+            auto& queues = Registry().queues;
+            for (auto itr = queues.begin(); itr != queues.end();)
+            {
+                itr = itr->second.expired() ? queues.erase(itr) : ++itr;
+            }
+            Registry().active = queues.size();
+        }
+
+        void Enqueued(cl_command_queue queue, CLOp::Type type, const std::string& name, size_t bytes, size_t global,
+                      long long submit, long long returned, cl_event event);
+
+        std::mutex lock;
+        std::vector<Record> records;
+        std::map<std::thread::id, size_t> threads;
+        long long origin;
+        size_t generation;  // Keeps pending callbacks off records added after Clear()
+    };
+
+    CLTracer() : state(std::make_shared<State>())
+    {
+    }
+
+    // Traces every command enqueued on 'queue' through the wrappers until Detach() or the last copy of this
+    // tracer is gone. A queue can only be attached to one tracer at a time.
+    void Attach(cl_command_queue queue) const
+    {
+        std::lock_guard<std::mutex> guard(Registry().lock);
+
+        Registry().queues[queue] = this->state;
+        Registry().active = Registry().queues.size();
+    }
+    void Detach(cl_command_queue queue) const
+    {
+        std::lock_guard<std::mutex> guard(Registry().lock);
+
+        auto itr = Registry().queues.find(queue);
+        if (itr != Registry().queues.end() && itr->second.lock() == this->state)
+        {
+            Registry().queues.erase(itr);
+        }
+        Registry().active = Registry().queues.size();
+    }
+
+    // Tracer state of 'queue', empty unless one is attached. One relaxed load if no queue is traced at all.
+    static std::shared_ptr<State> Find(cl_command_queue queue)
+    {
+        if (!Registry().active.load(std::memory_order_relaxed))
+        {
+            return nullptr;
+        }
+
+        std::lock_guard<std::mutex> guard(Registry().lock);
+
+        auto itr = Registry().queues.find(queue);
+        return itr != Registry().queues.end() ? itr->second.lock() : nullptr;
+    }
+
+    size_t Records() const
+    {
+        std::lock_guard<std::mutex> guard(this->state->lock);
+        return this->state->records.size();
+    }
+
+    void Clear() const
+    {
+        std::lock_guard<std::mutex> guard(this->state->lock);
+
+        this->state->records.clear();
+        this->state->origin = Now();
+        this->state->generation++;
+    }
+
+    // Commands still running only appear on the host track, wait for them before writing the trace.
+    std::string Json() const
+    {
+        std::lock_guard<std::mutex> guard(this->state->lock);
+
+        auto& records = this->state->records;
+        auto  origin  = this->state->origin;
+
+        std::map<cl_command_queue, size_t> queues;
+        std::map<cl_command_queue, long long> offsets;
+        for (auto& r : records)
+        {
+            if (!queues.count(r.queue))
+            {
+                auto index = queues.size();
+                queues[r.queue] = index;
+            }
+
+            if (r.complete && r.profile.Queued && !offsets.count(r.queue))
+            {
+                offsets[r.queue] = r.submit - (long long)r.profile.Queued;
+            }
+        }
+
+        std::ostringstream json;
+        json << "{\"traceEvents\":[";
+        json << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Host\"}},";
+        json << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"tid\":0,\"args\":{\"name\":\"Device\"}}";
+
+        for (auto& t : this->state->threads)
+        {
+            json << ",{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t.second << ",\"args\":{\"name\":\"Thread " << t.second << "\"}}";
+        }
+        for (auto& q : queues)
+        {
+            json << ",{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":2,\"tid\":" << q.second << ",\"args\":{\"name\":\"Queue " << q.second << "\"}}";
+        }
+
+        for (auto& r : records)
+        {
+            auto name = Escape(r.name.empty() ? CLOp::Name(r.type) : r.name);
+            std::ostringstream args;
+            args << "{\"type\":\"" << CLOp::Name(r.type) << "\",\"bytes\":" << r.bytes << ",\"global\":" << r.global << "}";
+
+            json << ",{\"name\":\"" << name << "\",\"cat\":\"host\",\"ph\":\"X\",\"pid\":1,\"tid\":" << r.thread
+                 << ",\"ts\":" << Micro(r.submit - origin) << ",\"dur\":" << Micro(r.returned - r.submit) << ",\"args\":" << args.str() << "}";
+
+            if (r.complete && r.profile.End && offsets.count(r.queue))
+            {
+                auto start = (long long)r.profile.Start + offsets[r.queue] - origin;
+                json << ",{\"name\":\"" << name << "\",\"cat\":\"device\",\"ph\":\"X\",\"pid\":2,\"tid\":" << queues[r.queue]
+                     << ",\"ts\":" << Micro(start) << ",\"dur\":" << Micro((long long)r.profile.Duration()) << ",\"args\":" << args.str() << "}";
+            }
+        }
+
+        json << "],\"displayTimeUnit\":\"ns\"}";
+        return json.str();
+    }
+
+    bool Write(const std::string& path) const
+    {
+        std::ofstream file(path, std::ios::out | std::ios::trunc);
+        if (!file)
+        {
+            return false;
+        }
+
+        file << this->Json();
+        return !!file;
+    }
+
+    static long long Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+protected:
+    struct Queues
+    {
+        Queues() : active(0) {}
+
+        std::mutex lock;
+        std::map<cl_command_queue, std::weak_ptr<State>> queues;
+        std::atomic<size_t> active;
+    };
+
+    static Queues& Registry()
+    {
+        static Queues registry;
+        return registry;
+    }
+
+    static std::string Micro(long long ns)
+    {
+        char text[32];
+        snprintf(text, sizeof(text), "%.3f", ns / 1000.0);
+        return text;
+    }
+
+    static std::string Escape(const std::string& text)
+    {
+        std::string escaped;
+        for (auto c : text)
+        {
+            if ('"' == c || '\\' == c)
+            {
+                escaped += '\\';
+            }
+            escaped += (unsigned char)c < 0x20 ? ' ' : c;
+        }
+        return escaped;
+    }
+
+protected:
+    std::shared_ptr<State> state;
+};
+
+inline void CLTracer::State::Enqueued(cl_command_queue queue, CLOp::Type type, const std::string& name, size_t bytes, size_t global,
+                                      long long submit, long long returned, cl_event event)
+{
+    size_t index, generation;
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+
+        auto thread = this->threads.find(std::this_thread::get_id());
+        if (thread == this->threads.end())
+        {
+            thread = this->threads.insert(std::make_pair(std::this_thread::get_id(), this->threads.size())).first;
+        }
+
+        Record record;
+        record.type     = type;
+        record.name     = name;
+        record.bytes    = bytes;
+        record.global   = global;
+        record.thread   = thread->second;
+        record.queue    = queue;
+        record.submit   = submit;
+        record.returned = returned;
+        record.complete = false;
+
+        index = this->records.size();
+        generation = this->generation;
+        this->records.push_back(record);
+    }
+
+    if (!event)
+    {
+        return;
+    }
+
+    // Profiling info is final once the command completed, pick it up from the callback thread.
+    std::weak_ptr<State> weak = this->shared_from_this();
+
+    CLEvent evt(event);
+    evt.OnComplete([weak, evt, index, generation](cl_int status)
+    {
+        auto state = weak.lock();
+        if (!state || status < 0)
+        {
+            return;
+        }
+
+        auto profile = evt.Profile();
+
+        std::lock_guard<std::mutex> guard(state->lock);
+        if (generation == state->generation && index < state->records.size())
+        {
+            state->records[index].profile  = profile;
+            state->records[index].complete = true;
+        }
+    });
+}
+
+// Hooks one enqueue into the counters, the latency histograms and the tracer of its queue. Costs a few
+// relaxed atomics when neither latencies nor the queue are traced.
+class CLProbe
+{
+public:
+    CLProbe(cl_command_queue queue, CLOp::Type type, size_t bytes = 0, size_t global = 0)
+        : queue(queue), type(type), bytes(bytes), global(global), state(CLTracer::Find(queue)),
+          latency(CLLatency::Global().Enabled()), submit(0)
+    {
+        if (this->state || this->latency)
+        {
+            this->submit = CLTracer::Now();
+        }
+    }
+
+    // Whether the command has to return an event even in event-less mode.
+    bool Wants() const
+    {
+        return this->state || this->latency;
+    }
+
+    void Name(const std::string& name)
+    {
+        this->name = name;
+    }
+
+    // Called once the command was enqueued successfully.
+    void Done(cl_event event) const
+    {
+        CLCounters::Global().Enqueued(this->type, this->bytes);
+
+        if (this->state)
+        {
+            this->state->Enqueued(this->queue, this->type, this->name, this->bytes, this->global, this->submit, CLTracer::Now(), event);
+        }
+
+        if (this->latency)
+        {
+            CLLatency::Global().Watch(this->type, this->name, (uint64_t)this->submit, event);
+        }
+    }
+
+protected:
+    cl_command_queue queue;
+    CLOp::Type  type;
+    size_t      bytes;
+    size_t      global;
+    std::string name;
+    std::shared_ptr<CLTracer::State> state;
+    bool        latency;
+    long long   submit;
+};
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "CLDevice.h"
+#include "CLKernelVariants.h"
+#include <string>
+
+// Element-wise kernels written once over VEC elements per work-item and built with VEC matched to the
+// device, see CLKernelVariants. CPUs prefer wide vectors, most GPUs scalars. Source() prepends macros for
+// the kernel side:
+//
+//   VTYPE(t)          t, or the vector type of t with VEC elements
+//   VLOAD(i, p)       VEC elements from p at i * VEC
+//   VSTORE(v, i, p)   VEC elements to p at i * VEC
+//   VFULL(i, count)   true if all VEC elements of work-item i are below count, the last one takes the
+//                     remaining elements one by one
+//
+// and Global() gives the matching number of work-items.
+class CLVector
+{
+public:
+    static const size_t Max = 16;
+
+    // 'source' with the VEC macros in front, build log lines still refer to 'source'.
+    static std::string Source(const std::string& source)
+    {
+        return std::string(
+            "#ifndef VEC\n"
+            "#define VEC 1\n"
+            "#endif\n"
+            "#define VCAT_(a, b) a##b\n"
+            "#define VCAT(a, b) VCAT_(a, b)\n"
+            "#if VEC == 1\n"
+            "#define VTYPE(t) t\n"
+            "#define VLOAD(i, p) ((p)[i])\n"
+            "#define VSTORE(v, i, p) ((p)[i] = (v))\n"
+            "#else\n"
+            "#define VTYPE(t) VCAT(t, VEC)\n"
+            "#define VLOAD(i, p) VCAT(vload, VEC)(i, p)\n"
+            "#define VSTORE(v, i, p) VCAT(vstore, VEC)(v, i, p)\n"
+            "#endif\n"
+            "#define VFULL(i, count) (((i) + 1) * VEC <= (count))\n"
+            "#line 1\n") + source;
+    }
+
+    // Preferred vector width of T on 'device' rounded down to a power of two up to Max, at least 1.
+    template<typename T>
+    static size_t Width(const CLDevice& device)
+    {
+        auto preferred = device.PreferredVectorWidth(CLType<T>::Name());
+
+        size_t width = 1;
+        while (width * 2 <= preferred && width * 2 <= Max)
+        {
+            width *= 2;
+        }
+        return width;
+    }
+
+    // Binds T to the element type and VEC to 'width'.
+    template<typename T>
+    static CLDefines Defines(size_t width, const std::string& type = "T")
+    {
+        return CLDefines().Type<T>(type).Value("VEC", width);
+    }
+
+    // Work-items covering 'count' elements at 'width' per item, rounded up to a multiple of 'local'.
+    static size_t Global(size_t count, size_t width, size_t local = 0)
+    {
+        auto items = (count + width - 1) / width;
+        return local ? (items + local - 1) / local * local : items;
+    }
+};
\ No newline at end of file
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <CL/cl.h>
+#include <cstddef>
+#include <initializer_list>
+#include <vector>
+
+// Non-owning view of a wait list argument, built from a braced list, a vector or a pointer and count
+// without copying. Only meant as a parameter type, the viewed events must outlive the call. A braced list
+// only lives until the end of the full expression, so 'CLWaits waits = { a, b };' as a local dangles, keep
+// such events in a vector or CLEventSet instead.
+class CLWaits
+{
+public:
+    CLWaits() : events(nullptr), count(0)
+    {
+    }
+    CLWaits(const std::initializer_list<cl_event>& events) : list(events), events(nullptr), count(events.size())
+    {
+    }
+    CLWaits(const std::vector<cl_event>& events) : events(events.data()), count(events.size())
+    {
+    }
+    CLWaits(const cl_event* events, size_t count) : events(events), count(count)
+    {
+    }
+
+    const cl_event* begin() const
+    {
+        return this->events ? this->events : this->list.begin();
+    }
+    const cl_event* end() const
+    {
+        return this->begin() + this->count;
+    }
+
+    size_t Size() const
+    {
+        return this->count;
+    }
+
+protected:
+    std::initializer_list<cl_event> list;
+    const cl_event* events;
+    size_t count;
+};
+
+// Wait list handed to the driver with null events dropped. Lives on the stack and only spills to the heap
+// past Inline events, so enqueue calls do not allocate in the common case.
+class CLWaitList
+{
+public:
+    static const size_t Inline = 16;
+
+    CLWaitList() : count(0)
+    {
+    }
+    CLWaitList(const CLWaits& waits) : CLWaitList()
+    {
+        for (auto e : waits)
+        {
+            this->Add(e);
+        }
+    }
+    CLWaitList(const CLWaitList&) = delete;
+    CLWaitList& operator=(const CLWaitList&) = delete;
+
+    void Add(cl_event event)
+    {
+        if (!event)
+        {
+            return;
+        }
+
+        if (this->count < Inline)
+        {
+            this->events[this->count] = event;
+        }
+        else
+        {
+            if (this->spill.empty())
+            {
+                this->spill.assign(this->events, this->events + Inline);
+            }
+            this->spill.push_back(event);
+        }
+        this->count++;
+    }
+
+    cl_uint Size() const
+    {
+        return (cl_uint)this->count;
+    }
+
+    // nullptr for an empty list, as the OpenCL API requires.
+    const cl_event* Data() const
+    {
+        return !this->count ? nullptr : this->count <= Inline ? this->events : this->spill.data();
+    }
+
+protected:
+    cl_event events[Inline];
+    size_t   count;
+    std::vector<cl_event> spill;
+};
\ No newline at end of file
@@ -0,0 +1,6 @@
+#include "Test.h"
+
+int main()
+{
+    return Test().HazardTrack();
+}
\ No newline at end of file
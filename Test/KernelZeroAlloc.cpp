@@ -0,0 +1,28 @@
+#include "Test.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Counts every heap allocation of the process, drivers included. Only this test replaces the allocator.
+static std::atomic<size_t> allocations(0);
+
+void* operator new(size_t size)
+{
+    allocations++;
+
+    auto p = malloc(size ? size : 1);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+int main()
+{
+    return Test().KernelZeroAlloc(allocations);
+}
\ No newline at end of file
@@ -0,0 +1,6 @@
+#include "Test.h"
+
+int main()
+{
+    return Test().QueueTrace();
+}
\ No newline at end of file
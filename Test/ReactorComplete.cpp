@@ -0,0 +1,6 @@
+#include "Test.h"
+
+int main()
+{
+    return Test().ReactorComplete();
+}
\ No newline at end of file
@@ -1,10 +1,28 @@
 #include "Test.h"
+#include "program_cl.h"
+#include "vector_cl.h"
 #include <CLBuffer.h>
+#include <CLEventSet.h>
+#include <CLGraph.h>
 #include <CLImage.h>
 #include <CLKernel.h>
+#include <CLKernelVariants.h>
+#include <CLMultiDevice.h>
+#include <CLProgramBuilder.h>
+#include <CLProgramBundle.h>
+#include <CLProgramCache.h>
+#include <CLProgramTuner.h>
+#include <CLQueuePool.h>
+#include <CLReactor.h>
+#include <CLTrace.h>
+#include <CLVector.h>
+#include <algorithm>
 #include <fstream>
 #include <random>
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
 
 #define ASSERT(o) if (!o || 0 != o.Error()) return -1
 #define DIVUP(a, b) ((a + b - 1) / b)
@@ -910,6 +928,336 @@ int Test::KernelSumup()
     return 0;
 }
 
+int Test::KernelVariants()
+{
+    if (!*this)
+    {
+        return -1;
+    }
+
+    CLKernelVariants variants(this->context, program_cl);
+
+    const int power = 8;
+
+    auto arr = CLBuffer<float>::Create(this->context, CLFlags::RW, 1 << power);
+    ASSERT(arr);
+
+    vector<float> values(arr.Length());
+    default_random_engine e;
+    uniform_real_distribution<float> d(-1.0f, 1.0f);
+    for (auto& value : values)
+    {
+        value = d(e);
+    }
+
+    if (!arr.Write(this->queue, values.data()))
+    {
+        return -1;
+    }
+
+    auto btsort = variants.Kernel("btsort", CLDefines().Type<float>("T"));
+    if (!btsort)
+    {
+        return -1;
+    }
+    btsort.Size({ arr.Length() / 2 });
+
+    for (int i = 0; i < power; i++)
+    {
+        for (int j = i; j >= 0; j--)
+        {
+            if (!btsort.Args(j, 2 << i, arr) || !btsort.Execute(this->queue))
+            {
+                return -1;
+            }
+        }
+    }
+
+    if (!arr.Read(this->queue, &values[0]) || !is_sorted(values.begin(), values.end()))
+    {
+        return -1;
+    }
+
+    // Same parameters in another order reuse the variant, new ones build another.
+    if (!variants.Kernel("sumup", CLDefines().Value("TILE", 16).Type<float>("T")) ||
+        !variants.Kernel("btsort", CLDefines().Type<float>("T").Value("TILE", 16)) ||
+        2 != variants.Size())
+    {
+        return -1;
+    }
+    if (!variants.Kernel("btsort", CLDefines().Type<uint32_t>("T")) || 3 != variants.Size())
+    {
+        return -1;
+    }
+
+    if (variants.Kernel("btsort", CLDefines().Value("T", "unknown_t")) || variants.Log().empty() || 3 != variants.Size())
+    {
+        return -1;
+    }
+
+    // The failure is kept, asking again reports it without another build.
+    auto before = CLCounters::Global().Snapshot();
+    if (variants.Program(CLDefines().Value("T", "unknown_t")) || variants.Log().empty() ||
+        0 != (CLCounters::Global().Snapshot() - before).Builds)
+    {
+        return -1;
+    }
+
+    if (string("char") != CLType<char>::Name() || string("long") != CLType<long long>::Name() ||
+        string("ulong") != CLType<uint64_t>::Name())
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+int Test::KernelVector()
+{
+    if (!*this)
+    {
+        return -1;
+    }
+
+    CLKernelVariants variants(this->context, CLVector::Source(vector_cl));
+
+    // Not a multiple of any width, so the last work-item always takes a tail.
+    const cl_uint count = 1003;
+
+    auto x = CLBuffer<float>::Create(this->context, CLFlags::RO, count);
+    auto y = CLBuffer<float>::Create(this->context, CLFlags::RW, count);
+    ASSERT(x);
+    ASSERT(y);
+
+    vector<float> xs(count);
+    for (size_t i = 0; i < xs.size(); i++)
+    {
+        xs[i] = (float)i;
+    }
+    if (!x.Write(this->queue, xs.data()))
+    {
+        return -1;
+    }
+
+    auto device = this->context.Device();
+    cout << "Preferred float width " << device.PreferredVectorWidth("float") << ", native " << device.NativeVectorWidth("float") << endl;
+
+    vector<size_t> widths = { CLVector::Width<float>(device), 1, 4, 16 };
+    for (auto width : widths)
+    {
+        if (!y.Write(this->queue, vector<float>(count, 1.0f).data()))
+        {
+            return -1;
+        }
+
+        auto axpy = variants.Kernel("axpy", CLVector::Defines<float>(width));
+        if (!axpy)
+        {
+            cout << variants.Log() << endl;
+            return -1;
+        }
+
+        axpy.Args(2.0f, x, y, count);
+        axpy.Size({ CLVector::Global(count, width, 64) });
+        if (!axpy.Execute(this->queue))
+        {
+            return -1;
+        }
+
+        vector<float> ys(count);
+        if (!y.Read(this->queue, &ys[0]))
+        {
+            return -1;
+        }
+
+        for (size_t i = 0; i < ys.size(); i++)
+        {
+            if (2.0f * i + 1.0f != ys[i])
+            {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int Test::KernelEventless()
+{
+    if (!*this || !this->CreateProgram())
+    {
+        return -1;
+    }
+
+    const size_t length = 256;
+
+    vector<int> input(length);
+    for (size_t i = 0; i < length; i++)
+    {
+        input[i] = (int)(i * 3);
+    }
+
+    auto src = CLBuffer<int>::Create(this->context, CLFlags::RO, length);
+    auto dst = CLBuffer<int>::Create(this->context, CLFlags::WO, length);
+    ASSERT(src);
+    ASSERT(dst);
+
+    src.Eventless(true);
+    dst.Eventless(true);
+
+    if (!src.Write(this->queue, input.data(), {}) || src.Event())
+    {
+        return -1;
+    }
+
+    auto copy = CLKernel::Create(this->program, "copyIntArray");
+    ASSERT(copy);
+
+    copy.Eventless(true);
+    copy.Args(src, dst);
+    copy.Size({ length });
+
+    // In-order queue, no wait lists needed.
+    for (int i = 0; i < 100; i++)
+    {
+        if (!copy.Execute(this->queue, {}) || copy.Event())
+        {
+            return -1;
+        }
+    }
+
+    copy.Wait();
+    if (copy.Error())
+    {
+        return -1;
+    }
+
+    // Synchronous calls still complete before returning.
+    vector<int> output(length, 0);
+    if (!dst.Read(this->queue, &output[0]) || output != input)
+    {
+        return -1;
+    }
+
+    // Hazard tracking needs the events back.
+    dst.Track(true);
+    if (!dst.Read(this->queue, &output[0], {}) || !dst.Event())
+    {
+        return -1;
+    }
+    dst.Wait();
+
+    copy.Args(src, dst);
+    if (!copy.Execute(this->queue, {}) || !copy.Event())
+    {
+        return -1;
+    }
+    copy.Wait();
+
+    return copy.Error() || dst.Error() ? -1 : 0;
+}
+
+int Test::KernelZeroAlloc(const atomic<size_t>& allocations)
+{
+    if (!*this || !this->CreateProgram())
+    {
+        return -1;
+    }
+
+    const size_t length = 256;
+    const size_t rounds = 1000;
+
+    vector<int> input(length, 1), output(length, 0);
+
+    auto src = CLBuffer<int>::Create(this->context, CLFlags::RO, length);
+    auto dst = CLBuffer<int>::Create(this->context, CLFlags::WO, length);
+    ASSERT(src);
+    ASSERT(dst);
+
+    auto copy = CLKernel::Create(this->program, "copyIntArray");
+    ASSERT(copy);
+
+    // Event-less, so the wrappers issue exactly the driver calls of the plain path below.
+    src.Eventless(true);
+    dst.Eventless(true);
+    copy.Eventless(true);
+
+    copy.Args(src, dst);
+    copy.Size({ length });
+
+    size_t origin[3] = { 0, 0, 0 };
+    size_t region[3] = { length * sizeof(int), 1, 1 };
+
+    // The same commands through the plain API, whatever the driver allocates by itself.
+    auto raw = [&]() -> cl_int
+    {
+        auto error = clEnqueueWriteBufferRect(this->queue, src, CL_FALSE, origin, origin, region, 0, 0, 0, 0, input.data(), 0, nullptr, nullptr);
+        if (CL_SUCCESS != error)
+        {
+            return error;
+        }
+        error = clEnqueueNDRangeKernel(this->queue, copy, 1, nullptr, &length, nullptr, 0, nullptr, nullptr);
+        if (CL_SUCCESS != error)
+        {
+            return error;
+        }
+        error = clEnqueueReadBufferRect(this->queue, dst, CL_FALSE, origin, origin, region, 0, 0, 0, 0, &output[0], 0, nullptr, nullptr);
+        if (CL_SUCCESS != error)
+        {
+            return error;
+        }
+        return clFinish(this->queue);
+    };
+
+    auto wrapped = [&]() -> cl_int
+    {
+        // In-order queue, the synchronous read finishes it and covers the scope guard as well.
+        if (!src.Write(this->queue, input.data(), {}) || !copy.Execute(this->queue, {}) || !dst.Read(this->queue, &output[0]))
+        {
+            return -1;
+        }
+        return dst.Error();
+    };
+
+    // Let the driver settle its pools first.
+    for (size_t i = 0; i < rounds / 10; i++)
+    {
+        if (CL_SUCCESS != raw() || CL_SUCCESS != wrapped())
+        {
+            return -1;
+        }
+    }
+
+    auto before = allocations.load();
+    for (size_t i = 0; i < rounds; i++)
+    {
+        if (CL_SUCCESS != raw())
+        {
+            return -1;
+        }
+    }
+    auto baseline = allocations.load() - before;
+
+    before = allocations.load();
+    for (size_t i = 0; i < rounds; i++)
+    {
+        if (CL_SUCCESS != wrapped())
+        {
+            return -1;
+        }
+    }
+    auto measured = allocations.load() - before;
+
+    // The wrappers add nothing of their own on top of the driver.
+    if (measured > baseline)
+    {
+        cout << "Allocations: " << baseline << " plain, " << measured << " wrapped" << endl;
+        return -1;
+    }
+
+    return output == input ? 0 : -1;
+}
+
 int Test::EventMapCopy()
 {
     if (!*this)
@@ -1084,60 +1432,1506 @@ int Test::EventExecute()
     return 0;
 }
 
-int Test::ProgramBinary()
+int Test::EventProfile()
 {
     if (!*this || !this->CreateProgram())
     {
         return -1;
     }
 
-    vector<vector<uint8_t>> binaries;
-    if (!this->program.GetBinary(binaries))
+    CLQueueOptions options;
+    options.Profiling = true;
+
+    auto queue = CLQueue::Create(this->context, this->context.Device(), options);
+    if (!queue || !queue.Profiling())
     {
         return -1;
     }
 
-    ofstream out("binary.bin", ios::binary | ios::trunc);
-    if (!this->program.Save(out))
+    const size_t length = 1 << 16;
+
+    auto src = CLBuffer<int>::Create(this->context, CLFlags::RO, length);
+    auto dst = CLBuffer<int>::Create(this->context, CLFlags::WO, length);
+    ASSERT(src);
+    ASSERT(dst);
+
+    if (!src.Write(queue, vector<int>(length, 1).data()))
     {
         return -1;
     }
-    out.close();
 
-    string log;
-    vector<cl_int> status;
-    ifstream in("binary.bin", ios::binary);
+    auto write = src.Event().Profile();
+    if (!write.End || write.Start > write.End || write.Duration() > write.Latency())
+    {
+        return -1;
+    }
 
-    this->program = CLProgram::Load(this->context, in, log, &status);
-    if (!this->program)
+    auto copy = CLKernel::Create(this->program, "copyIntArray");
+    ASSERT(copy);
+
+    copy.Args(src, dst);
+    copy.Size({ length });
+    if (!copy.Execute(queue))
     {
         return -1;
     }
 
-    auto kernel = CLKernel::Create(this->program, "btsort");
-    if (!kernel)
+    auto exec = copy.Event().Profile();
+    if (exec.Queued > exec.Submit || exec.Submit > exec.Start || exec.Start > exec.End || exec.End > exec.Complete)
+    {
+        return -1;
+    }
+
+    if (exec.Start < write.End)
     {
         return -1;
     }
 
+    cout << "Write: " << write.Duration() << "ns" << endl;
+    cout << "Copy:  " << exec.Duration()  << "ns" << endl;
+
     return 0;
 }
 
-bool Test::CreateProgram()
+int Test::EventWaitPolicy()
 {
-    if (this->program)
+    if (!*this || !this->CreateProgram())
     {
-        return true;
+        return -1;
     }
 
-    ifstream file("program.cl");
-    if (!file.is_open())
+    const size_t length = 256;
+
+    auto src = CLBuffer<int>::Create(this->context, CLFlags::RO, length);
+    auto dst = CLBuffer<int>::Create(this->context, CLFlags::WO, length);
+    ASSERT(src);
+    ASSERT(dst);
+
+    if (!src.Write(this->queue, vector<int>(length, 5).data()))
     {
-        return false;
+        return -1;
+    }
+
+    auto copy = CLKernel::Create(this->program, "copyIntArray");
+    ASSERT(copy);
+
+    copy.Args(src, dst);
+    copy.Size({ length });
+
+    auto spin     = CLWaitPolicy::Spinning(chrono::microseconds(200));
+    auto adaptive = CLWaitPolicy::Adapting(chrono::microseconds(200));
+
+    for (int i = 0; i < 10; i++)
+    {
+        if (!copy.Execute(this->queue, {}) || CL_SUCCESS != copy.Wait(i % 2 ? spin : adaptive))
+        {
+            return -1;
+        }
+    }
+
+    // Gate the kernel on a user event so the timed wait has to give up.
+    auto user = CLEvent::CreateUser(this->context);
+    if (!user)
+    {
+        return -1;
+    }
+
+    if (!copy.Execute(this->queue, { user }))
+    {
+        return -1;
+    }
+    clFlush(this->queue);
+
+    if (copy.Wait(CLWaitPolicy::Adapting(chrono::microseconds(50), chrono::microseconds(2000))) <= CL_COMPLETE || copy.Error())
+    {
+        return -1;
+    }
+
+    user.Signal();
+
+    if (CL_SUCCESS != copy.Wait(CLWaitPolicy::Blocking(chrono::microseconds(1000000))))
+    {
+        return -1;
+    }
+
+    // Synchronous calls go through the default policy.
+    CLWaitPolicy::Default(spin);
+    vector<int> result(length, 0);
+    auto read = dst.Read(this->queue, &result[0]);
+    CLWaitPolicy::Default(CLWaitPolicy());
+
+    if (!read || dst.Error())
+    {
+        return -1;
+    }
+
+    for (auto v : result)
+    {
+        if (5 != v)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int Test::EventSet()
+{
+    if (!*this || !this->CreateProgram())
+    {
+        return -1;
+    }
+
+    const size_t length = 128;
+
+    vector<int> a(length), b(length);
+    for (size_t i = 0; i < length; i++)
+    {
+        a[i] = (int)i;
+        b[i] = (int)(length - i);
+    }
+
+    auto srcA = CLBuffer<int>::Create(this->context, CLFlags::RO, length);
+    auto srcB = CLBuffer<int>::Create(this->context, CLFlags::RO, length);
+    auto dstA = CLBuffer<int>::Create(this->context, CLFlags::RW, length);
+    auto dstB = CLBuffer<int>::Create(this->context, CLFlags::RW, length);
+    ASSERT(srcA);
+    ASSERT(srcB);
+    ASSERT(dstA);
+    ASSERT(dstB);
+
+    if (!srcA.Write(this->queue, a.data(), {}) || !srcB.Write(this->queue, b.data(), {}))
+    {
+        return -1;
+    }
+
+    CLEventSet uploads{ srcA, srcB };
+    if (2 != uploads.Size() || CLEventSet::npos == uploads.WaitAny() || uploads.Error())
+    {
+        return -1;
+    }
+
+    auto copyA = CLKernel::Create(this->program, "copyIntArray");
+    auto copyB = CLKernel::Create(this->program, "copyIntArray");
+    ASSERT(copyA);
+    ASSERT(copyB);
+
+    copyA.Args(srcA, dstA);
+    copyA.Size({ length });
+    copyB.Args(srcB, dstB);
+    copyB.Size({ length });
+
+    if (!copyA.Execute(this->queue, uploads) || !copyB.Execute(this->queue, uploads))
+    {
+        return -1;
+    }
+
+    // Fan-in of both kernels into one event.
+    auto done = CLEventSet{ copyA, copyB }.Merge(this->queue);
+    if (!done)
+    {
+        return -1;
+    }
+
+    vector<int> ra(length), rb(length);
+    if (!dstA.Read(this->queue, &ra[0], { done }) || !dstB.Read(this->queue, &rb[0], { done }))
+    {
+        return -1;
+    }
+
+    CLEventSet reads;
+    reads.Add(dstA).Add(dstB).Add(nullptr);
+    if (2 != reads.Size() || CL_SUCCESS != reads.WaitAll())
+    {
+        return -1;
+    }
+
+    if (ra != a || rb != b || CLEventSet::npos == reads.Completed())
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+int Test::EventUserGate()
+{
+    if (!*this || !this->CreateProgram())
+    {
+        return -1;
+    }
+
+    const size_t length = 128;
+
+    auto src = CLBuffer<int>::Create(this->context, CLFlags::RO, length);
+    auto dst = CLBuffer<int>::Create(this->context, CLFlags::WO, length);
+    ASSERT(src);
+    ASSERT(dst);
+
+    auto copy = CLKernel::Create(this->program, "copyIntArray");
+    ASSERT(copy);
+
+    copy.Args(src, dst);
+    copy.Size({ length });
+
+    for (int round = 0; round < 3; round++)
+    {
+        auto gate = CLEvent::CreateUser(this->context);
+        if (!gate)
+        {
+            return -1;
+        }
+
+        // Stage the whole chain before the input exists.
+        vector<int> input(length, 0), output(length, -1);
+        if (!src.Write(this->queue, input.data(), { gate }) ||
+            !copy.Execute(this->queue, { src }) ||
+            !dst.Read(this->queue, &output[0], { copy }))
+        {
+            gate.Signal(CL_INVALID_OPERATION);
+            return -1;
+        }
+        clFlush(this->queue);
+
+        // Nothing may run before the gate opens.
+        if (CL_COMPLETE >= dst.Event().Status())
+        {
+            gate.Signal(CL_INVALID_OPERATION);
+            return -1;
+        }
+
+        for (size_t i = 0; i < length; i++)
+        {
+            input[i] = (int)(i * round);
+        }
+
+        if (CL_SUCCESS != gate.Signal())
+        {
+            return -1;
+        }
+
+        dst.Wait();
+        if (dst.Error())
+        {
+            return -1;
+        }
+
+        if (output != input)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int Test::ProgramBinary()
+{
+    if (!*this || !this->CreateProgram())
+    {
+        return -1;
+    }
+
+    vector<vector<uint8_t>> binaries;
+    if (!this->program.GetBinary(binaries))
+    {
+        return -1;
+    }
+
+    ofstream out("binary.bin", ios::binary | ios::trunc);
+    if (!this->program.Save(out))
+    {
+        return -1;
+    }
+    out.close();
+
+    string log;
+    vector<cl_int> status;
+    ifstream in("binary.bin", ios::binary);
+
+    this->program = CLProgram::Load(this->context, in, log, &status);
+    if (!this->program)
+    {
+        return -1;
+    }
+
+    auto kernel = CLKernel::Create(this->program, "btsort");
+    if (!kernel)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+int Test::ProgramKernels()
+{
+    if (!*this || !this->CreateProgram())
+    {
+        return -1;
+    }
+
+    auto kernels = this->program.Kernels();
+    if (kernels.size() < 4)
+    {
+        return -1;
+    }
+
+    for (auto& kernel : kernels)
+    {
+        if (!kernel || kernel.Name().empty())
+        {
+            return -1;
+        }
+    }
+
+    // Every copy of the program shares the cache, so lookups hand out the same kernel object.
+    CLProgram copy = this->program;
+    auto& btsort = this->program.Kernel("btsort");
+    if (!btsort || &btsort != &copy.Kernel("btsort") || (cl_kernel)btsort != (cl_kernel)copy.Kernel("btsort"))
+    {
+        return -1;
+    }
+
+    if (this->program.Kernel("missing"))
+    {
+        return -1;
+    }
+
+    auto clone = this->program.Clone("sumup");
+    if (!clone || (cl_kernel)clone == (cl_kernel)this->program.Kernel("sumup") || clone.Name() != "sumup")
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+int Test::ProgramBundle()
+{
+    if (!*this || !this->CreateProgram())
+    {
+        return -1;
+    }
+
+    {
+        ofstream out("program.oclb", ios::binary | ios::trunc);
+        if (!CLProgramBundle::Save(out, this->program, ""))
+        {
+            return -1;
+        }
+    }
+
+    string log;
+    CLProgramBundle bundle;
+    if (!bundle.Open("program.oclb", log) || bundle.Count() != 1 || bundle.Name(0) != this->context.Device().Name())
+    {
+        cout << log << endl;
+        return -1;
+    }
+
+    // Bundles built with other options are turned down before the driver sees them.
+    if (bundle.Matches(this->context, "-cl-fast-relaxed-math", log) || bundle.Load(this->context, "-cl-fast-relaxed-math", log))
+    {
+        return -1;
+    }
+
+    auto program = bundle.Load(this->context, "", log);
+    if (!program || !CLKernel::Create(program, "btsort"))
+    {
+        cout << log << endl;
+        return -1;
+    }
+    bundle.Close();
+
+    // A flipped byte in the binary fails its CRC.
+    {
+        fstream file("program.oclb", ios::binary | ios::in | ios::out);
+        file.seekp(-1, ios::end);
+        file.put('\x5A' ^ (char)file.peek());
+    }
+
+    if (!bundle.Open("program.oclb", log) || bundle.Load(this->context, "", log))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+int Test::ProgramCache()
+{
+    if (!*this)
+    {
+        return -1;
+    }
+
+    string source(program_cl, program_cl_size);
+
+    CLProgramCache cache("program_cache");
+
+    auto path = cache.Path(this->context, source.c_str(), "");
+    remove(path.c_str());
+
+    // Cold start builds from source and stores the binaries, the next one loads them.
+    bool hit = true;
+    string log;
+    if (!cache.Create(this->context, source.c_str(), "", log, &hit) || hit)
+    {
+        return -1;
+    }
+    auto program = cache.Create(this->context, source.c_str(), "", log, &hit);
+    if (!program || !hit || !CLKernel::Create(program, "btsort"))
+    {
+        return -1;
+    }
+
+    // Other options make another entry.
+    if (cache.Path(this->context, source.c_str(), "-cl-mad-enable") == path)
+    {
+        return -1;
+    }
+
+    // A corrupt entry falls back to a source build and gets replaced.
+    {
+        ofstream corrupt(path, ios::binary | ios::trunc);
+        corrupt << "garbage";
+    }
+    if (!cache.Create(this->context, source.c_str(), "", log, &hit) || hit)
+    {
+        return -1;
+    }
+    if (!cache.Create(this->context, source.c_str(), "", log, &hit) || !hit)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+int Test::ProgramTune()
+{
+    if (!*this)
+    {
+        return -1;
+    }
+
+    const size_t width  = 512;
+    const size_t height = 512;
+    const size_t cols   = 16;
+    const size_t rows   = 16;
+
+    auto values = CLBuff2D<float>::Create(this->context, CLFlags::RO, width, height);
+    if (!values.Write(this->queue, vector<float>(values.Width() * values.Height(), 0.5f).data()))
+    {
+        return -1;
+    }
+
+    size_t xgroups = DIVUP(values.Width(),  cols);
+    size_t ygroups = DIVUP(values.Height(), rows);
+    auto sumups = CLBuffer<float>::Create(this->context, CLFlags::WO, xgroups * ygroups);
+
+    // Sums all values and compares against the exact result.
+    auto benchmark = [&](const CLProgram& program)
+    {
+        auto& sumup = program.Kernel("sumup");
+        sumup.Args(values, PITCH(values), (cl_uint)values.Width(), (cl_uint)values.Height(), sumups, CLLocal<float>(cols * rows));
+        sumup.Size({ xgroups * cols, ygroups * rows }, { cols, rows });
+        if (!sumup.Execute(this->queue))
+        {
+            return false;
+        }
+
+        vector<float> partial(sumups.Length());
+        if (!sumups.Read(this->queue, &partial[0]))
+        {
+            return false;
+        }
+
+        double sum = 0;
+        for (auto value : partial)
+        {
+            sum += value;
+        }
+        vector<double> result(1, sum), reference(1, 0.5 * width * height);
+        return CLProgramTuner::Within(result, reference, 1e-5);
+    };
+
+    auto cache = make_shared<CLProgramCache>("program_cache");
+
+    string log;
+    CLProgramTuner tuner(this->context, program_cl, "-DT=float", cache);
+    tuner.Relaxations().Candidate("-cl-mad-enable -DUNUSED=1");
+    tuner.Runs(3);
+    tuner.Forget();
+
+    auto program = tuner.Tune(benchmark, log);
+    if (!program || 6 != tuner.Results().size())
+    {
+        cout << log << endl;
+        return -1;
+    }
+
+    for (auto& result : tuner.Results())
+    {
+        cout << (result.Options.empty() ? "(base)" : result.Options) << ": " << result.Time << " ns " << result.Log << endl;
+    }
+    cout << "Winner: " << tuner.Options() << endl;
+
+    // The next tuner with the same candidates builds the recorded winner without benchmarking.
+    CLProgramTuner again(this->context, program_cl, "-DT=float", cache);
+    again.Relaxations().Candidate("-cl-mad-enable -DUNUSED=1");
+
+    if (!again.Tune(benchmark, log) || !again.Results().empty() || again.Winner() != tuner.Winner())
+    {
+        return -1;
+    }
+
+    // Candidates failing the check never win.
+    CLProgramTuner rejected(this->context, program_cl, "-DT=float");
+    if (rejected.Tune([](const CLProgram&){ return false; }, log) || 1 != rejected.Results().size())
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+int Test::ProgramAsync()
+{
+    if (!*this)
+    {
+        return -1;
+    }
+
+    string source(program_cl, program_cl_size);
+
+    string log;
+    auto future = CLProgram::CreateAsync(this->context, source.c_str(), "", log);
+
+    auto program = future.get();
+    if (!program || !CLKernel::Create(program, "btsort"))
+    {
+        return -1;
+    }
+
+    string error;
+    if (CLProgram::CreateAsync(this->context, "kernel void broken(", "", error).get() || error.empty())
+    {
+        return -1;
+    }
+
+    CLProgramBuilder builder(4);
+    for (int i = 0; i < 4; i++)
+    {
+        builder.Add(this->context, source, "-DVARIANT=" + to_string(i));
+    }
+
+    if (!builder.Build() || 4 != builder.Size())
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i < builder.Size(); i++)
+    {
+        if (!CLKernel::Create(builder.Program(i), "btsort"))
+        {
+            return -1;
+        }
+    }
+
+    // One failed build fails the batch and keeps its log, the others still get built.
+    auto broken = builder.Add(this->context, "kernel void broken(");
+    auto scalar = builder.Add(this->context, source, "-DVARIANT=4");
+    if (builder.Build() || builder.Log(broken).empty() || !builder.Program(scalar))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+int Test::ProgramLink()
+{
+    if (!*this)
+    {
+        return -1;
+    }
+
+    map<string, string> headers;
+    headers["pitch.h"] = "#define PITCH(var) pitch__##var\n"
+                         "#define ROW2D(type, pointer, y) ((__global type*)((__global char*)(pointer) + (y) * PITCH(pointer)))\n"
+                         "int scale(int value);\n";
+
+    const char* helper = "#include \"pitch.h\"\n"
+                         "int scale(int value) { return value * 2; }\n";
+    const char* kernel = "#include \"pitch.h\"\n"
+                         "__kernel void scaleRows(__global int* rows, uint PITCH(rows))\n"
+                         "{\n"
+                         "    ROW2D(int, rows, get_global_id(1))[get_global_id(0)] = scale(get_global_id(0));\n"
+                         "}\n";
+
+    string log;
+    auto library = CLProgram::Library(this->context, { CLProgram::Compile(this->context, helper, headers, "", log) }, "", log);
+    if (!library)
+    {
+        return -1;
+    }
+
+    CLProgramCache cache("program_cache");
+    remove(cache.Path(this->context, kernel, headers, "").c_str());
+
+    bool hit = true;
+    auto object = cache.Compile(this->context, kernel, headers, "", log, &hit);
+    if (!object || hit)
+    {
+        return -1;
+    }
+
+    auto program = CLProgram::Link(this->context, { object, library }, "", log);
+    if (!program || !CLKernel::Create(program, "scaleRows"))
+    {
+        return -1;
+    }
+
+    // An unchanged unit comes from the cache and links as well.
+    object = cache.Compile(this->context, kernel, headers, "", log, &hit);
+    if (!object || !hit || !CLProgram::Link(this->context, { object, library }, "", log))
+    {
+        return -1;
+    }
+
+    // Unresolved symbols fail at link time and keep the log.
+    string error;
+    if (CLProgram::Link(this->context, { object }, "", error) || error.empty())
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+int Test::ProgramIL()
+{
+    if (!*this)
+    {
+        return -1;
+    }
+
+    // Nothing to test without SPIR-V tools at build time or IL support on the device.
+    if (!program_spv_size || this->context.Device().IL().empty())
+    {
+        return 0;
+    }
+
+    string log;
+    auto program = CLProgram::CreateFromIL(this->context, program_spv, program_spv_size, "", log);
+    if (!program)
+    {
+        cout << log << endl;
+        return -1;
+    }
+
+    auto kernel = CLKernel::Create(program, "btsort");
+    if (!kernel)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+int Test::MultiDeviceExecute()
+{
+    auto multi = CLMultiDevice::CreateDefault();
+    if (!multi)
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i < multi.Devices(); i++)
+    {
+        cout << "Device: " << multi.Device(i).Name() << endl;
+    }
+
+    string log;
+    auto program = CLProgram::Create(multi.Context(), program_cl, "", log);
+    if (!program)
+    {
+        return -1;
+    }
+
+    const size_t length = 1024;
+
+    auto& queue = multi.Queue(0);
+    auto src = CLBuffer<int>::Create(multi.Context(), CLFlags::RO, length);
+    auto dst = CLBuffer<int>::Create(multi.Context(), CLFlags::WO, length);
+    ASSERT(src);
+    ASSERT(dst);
+
+    vector<int> values(length);
+    for (size_t i = 0; i < length; i++)
+    {
+        values[i] = (int)i;
+    }
+
+    if (!src.Write(queue, values.data()))
+    {
+        return -1;
+    }
+
+    auto copy = CLKernel::Create(program, "copyIntArray");
+    ASSERT(copy);
+
+    copy.Args(src, dst);
+    copy.Size({ length });
+
+    // Rates start from the compute units * clock estimate and move once a round was measured, also when
+    // the asynchronous overload is only waited on through its event.
+    vector<double> seeds;
+    for (size_t i = 0; i < multi.Devices(); i++)
+    {
+        seeds.push_back(multi.Rate(i));
+    }
+
+    for (int round = 0; round < 2; round++)
+    {
+        if (!multi.Execute(copy, 1, dst, 0, {}) || CL_SUCCESS != multi.Event().Wait())
+        {
+            return -1;
+        }
+    }
+
+    bool moved = false;
+    for (size_t i = 0; i < multi.Devices(); i++)
+    {
+        moved = moved || multi.Rate(i) != seeds[i];
+    }
+    if (!moved)
+    {
+        return -1;
+    }
+
+    // Run a few rounds so shares get rebalanced from measured timings.
+    for (int round = 0; round < 3; round++)
+    {
+        if (!multi.Execute(copy, 1, dst))
+        {
+            return -1;
+        }
+
+        vector<int> result(length, -1);
+        if (!dst.Read(queue, &result[0]))
+        {
+            return -1;
+        }
+
+        for (size_t i = 0; i < length; i++)
+        {
+            if (result[i] != (int)i)
+            {
+                return -1;
+            }
+        }
+
+        double shares = 0;
+        for (size_t i = 0; i < multi.Devices(); i++)
+        {
+            cout << "Share " << i << ": " << multi.Share(i) << endl;
+            shares += multi.Share(i);
+        }
+
+        if (shares < 0.999 || shares > 1.001)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int Test::GraphExecute()
+{
+    if (!*this || !this->CreateProgram())
+    {
+        return -1;
+    }
+
+    CLQueueOptions options;
+    options.OutOfOrder = true;
+
+    // Out-of-order queues are optional, fall back to a second in-order queue.
+    auto ooo = CLQueue::Create(this->context, this->context.Device(), options);
+    if (!ooo)
+    {
+        ooo = CLQueue::Create(this->context);
+    }
+
+    const size_t length = 1024;
+
+    auto a = CLBuffer<int>::Create(this->context, CLFlags::RW, length);
+    auto b = CLBuffer<int>::Create(this->context, CLFlags::RW, length);
+    auto c = CLBuffer<int>::Create(this->context, CLFlags::RW, length);
+    auto d = CLBuffer<int>::Create(this->context, CLFlags::RW, length);
+    ASSERT(a);
+    ASSERT(b);
+    ASSERT(c);
+    ASSERT(d);
+
+    vector<int> va(length, 1);
+    vector<int> vb(length, 2);
+    vector<int> vc(length, 0);
+    vector<int> vd(length, 0);
+
+    auto ab = CLKernel::Create(this->program, "copyIntArray");
+    auto cd = CLKernel::Create(this->program, "copyIntArray");
+    ASSERT(ab);
+    ASSERT(cd);
+
+    ab.Args(a, c);
+    ab.Size({ length });
+    cd.Args(b, d);
+    cd.Size({ length });
+
+    CLGraph graph;
+    auto wa = graph.Add({}, { a }, [&](cl_command_queue queue, const vector<cl_event>& waits, CLEvent& event) -> cl_int
+    {
+        if (!a.Write(queue, va.data(), waits)) return a.Error();
+        event = a.Event();
+        return CL_SUCCESS;
+    });
+    auto wb = graph.Add({}, { b }, [&](cl_command_queue queue, const vector<cl_event>& waits, CLEvent& event) -> cl_int
+    {
+        if (!b.Write(queue, vb.data(), waits)) return b.Error();
+        event = b.Event();
+        return CL_SUCCESS;
+    });
+    auto ka = graph.Kernel(ab, { a }, { c });
+    auto kb = graph.Kernel(cd, { b }, { d });
+    auto rc = graph.Add({ c }, {}, [&](cl_command_queue queue, const vector<cl_event>& waits, CLEvent& event) -> cl_int
+    {
+        if (!c.Read(queue, &vc[0], waits)) return c.Error();
+        event = c.Event();
+        return CL_SUCCESS;
+    });
+    auto rd = graph.Add({ d }, {}, [&](cl_command_queue queue, const vector<cl_event>& waits, CLEvent& event) -> cl_int
+    {
+        if (!d.Read(queue, &vd[0], waits)) return d.Error();
+        event = d.Event();
+        return CL_SUCCESS;
+    });
+
+    // Overwriting 'a' has to wait for the kernel reading it, but not for anything else.
+    auto wa2 = graph.Copy(a, b);
+
+    atomic<int> sum(0);
+    auto host = graph.Host({ c, d }, {}, [&]{ sum = vc[0] + vd[0]; });
+
+    // Host memory is not tracked, the task reads what the read nodes filled in.
+    graph.Depend(host, rc);
+    graph.Depend(host, rd);
+
+    if (graph.Dependencies(ka) != vector<size_t>{ wa } ||
+        graph.Dependencies(kb) != vector<size_t>{ wb } ||
+        graph.Dependencies(rc) != vector<size_t>{ ka } ||
+        graph.Dependencies(rd) != vector<size_t>{ kb } ||
+        graph.Dependencies(wa2).size() != 2)
+    {
+        return -1;
+    }
+
+    if (!graph.Execute({ this->queue, ooo }))
+    {
+        return -1;
+    }
+    graph.Wait();
+
+    if (graph.Error())
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i < length; i++)
+    {
+        if (1 != vc[i] || 2 != vd[i])
+        {
+            return -1;
+        }
+    }
+
+    return 3 == sum ? 0 : -1;
+}
+
+int Test::HazardTrack()
+{
+    if (!*this || !this->CreateProgram())
+    {
+        return -1;
+    }
+
+    // Hazards only matter when commands may reorder, use an out-of-order queue when there is one.
+    CLQueueOptions options;
+    options.OutOfOrder = true;
+
+    auto queue = CLQueue::Create(this->context, this->context.Device(), options);
+    if (!queue)
+    {
+        queue = this->queue;
+    }
+
+    const size_t length = 1 << 16;
+
+    auto src = CLBuffer<int>::Create(this->context, CLFlags::RW, length);
+    auto dst = CLBuffer<int>::Create(this->context, CLFlags::RW, length);
+    ASSERT(src);
+    ASSERT(dst);
+
+    src.Track(true);
+    dst.Track(true);
+
+    auto copy = CLKernel::Create(this->program, "copyIntArray");
+    ASSERT(copy);
+
+    copy.Args(src, dst);
+    copy.Size({ length });
+    copy.Access(0, CLFlags::RO);
+    copy.Access(1, CLFlags::WO);
+
+    vector<int> ones(length, 1);
+    vector<int> twos(length, 2);
+    vector<int> result(length, 0);
+
+    // No wait lists given, ordering comes from tracked hazards only.
+    if (!src.Write(queue, ones.data(), {}) ||
+        !copy.Execute(queue, {})           ||
+        !src.Write(queue, twos.data(), {}) ||
+        !dst.Read(queue, &result[0], {}))
+    {
+        return -1;
+    }
+    dst.Wait();
+
+    for (size_t i = 0; i < length; i++)
+    {
+        if (1 != result[i])
+        {
+            return -1;
+        }
+    }
+
+    {
+        auto map = src.Map(queue, CLFlags::RW, {});
+        if (!map)
+        {
+            return -1;
+        }
+        map.Wait();
+
+        for (size_t i = 0; i < length; i++)
+        {
+            if (2 != map[i])
+            {
+                return -1;
+            }
+            map[i] = 3;
+        }
+        map.Unmap({});
+    }
+
+    if (!copy.Execute(queue, {}) ||
+        !dst.Read(queue, &result[0], {}))
+    {
+        return -1;
+    }
+    dst.Wait();
+
+    for (size_t i = 0; i < length; i++)
+    {
+        if (3 != result[i])
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int Test::QueuePool()
+{
+    if (!*this || !this->CreateProgram())
+    {
+        return -1;
+    }
+
+    auto pool = CLQueuePool::Create(this->context, this->context.Device(), 2, 2, 2);
+    if (!pool || 2 != pool.Uploads() || 2 != pool.Downloads() || 2 != pool.Computes())
+    {
+        return -1;
+    }
+
+    const size_t length = 1 << 16;
+    const size_t batches = 4;
+
+    auto copy = CLKernel::Create(this->program, "copyIntArray");
+    ASSERT(copy);
+
+    vector<CLBuffer<int>> srcs;
+    vector<CLBuffer<int>> dsts;
+    vector<vector<int>> inputs;
+    vector<vector<int>> outputs;
+
+    for (size_t i = 0; i < batches; i++)
+    {
+        srcs.push_back(CLBuffer<int>::Create(this->context, CLFlags::RO, length));
+        dsts.push_back(CLBuffer<int>::Create(this->context, CLFlags::WO, length));
+        ASSERT(srcs.back());
+        ASSERT(dsts.back());
+
+        inputs.push_back(vector<int>(length, (int)i));
+        outputs.push_back(vector<int>(length, -1));
+    }
+
+    // Uploads of later batches overlap kernels and downloads of earlier ones.
+    for (size_t i = 0; i < batches; i++)
+    {
+        if (!srcs[i].Write(pool.Upload(), inputs[i].data(), {}))
+        {
+            return -1;
+        }
+
+        copy.Args(srcs[i], dsts[i]);
+        copy.Size({ length });
+        if (!copy.Execute(pool.Compute(), { srcs[i] }))
+        {
+            return -1;
+        }
+
+        if (!dsts[i].Read(pool.Download(), &outputs[i][0], { copy }))
+        {
+            return -1;
+        }
+    }
+    pool.Flush();
+
+    for (size_t i = 0; i < batches; i++)
+    {
+        dsts[i].Wait();
+
+        for (size_t j = 0; j < length; j++)
+        {
+            if ((int)i != outputs[i][j])
+            {
+                return -1;
+            }
+        }
+    }
+
+    pool.Finish();
+
+    return 0;
+}
+
+int Test::QueueMarker()
+{
+    if (!*this || !this->CreateProgram())
+    {
+        return -1;
+    }
+
+    const size_t length = 128;
+
+    vector<int> input(length);
+    for (size_t i = 0; i < length; i++)
+    {
+        input[i] = (int)(length - i);
+    }
+
+    auto src = CLBuffer<int>::Create(this->context, CLFlags::RO, length);
+    auto dst = CLBuffer<int>::Create(this->context, CLFlags::WO, length);
+    ASSERT(src);
+    ASSERT(dst);
+
+    auto copy = CLKernel::Create(this->program, "copyIntArray");
+    ASSERT(copy);
+
+    copy.Args(src, dst);
+    copy.Size({ length });
+
+    if (!src.Write(this->queue, input.data(), {}))
+    {
+        return -1;
+    }
+
+    // Fence the upload stage and let the host carry on.
+    auto uploaded = this->queue.Marker({ src });
+    if (!uploaded || this->queue.Error())
+    {
+        return -1;
+    }
+
+    if (!copy.Execute(this->queue, { uploaded }))
+    {
+        return -1;
+    }
+
+    auto computed = this->queue.Barrier();
+    if (!computed || CL_SUCCESS != this->queue.Flush())
+    {
+        return -1;
+    }
+
+    vector<int> output(length, 0);
+    if (!dst.Read(this->queue, &output[0], { computed }))
+    {
+        return -1;
+    }
+
+    // An empty marker covers everything enqueued before it.
+    auto all = this->queue.Marker();
+    if (!all || CL_SUCCESS != all.Wait())
+    {
+        return -1;
+    }
+
+    if (CL_COMPLETE != dst.Event().Status() || CL_COMPLETE != computed.Status())
+    {
+        return -1;
+    }
+
+    return output == input ? 0 : -1;
+}
+
+int Test::QueueTrace()
+{
+    if (!*this || !this->CreateProgram())
+    {
+        return -1;
+    }
+
+    CLQueueOptions options;
+    options.Profiling = true;
+
+    auto queue = CLQueue::Create(this->context, nullptr, options);
+    if (!queue)
+    {
+        return -1;
+    }
+
+    CLTracer tracer;
+    queue.Trace(tracer);
+
+    const size_t length = 1024;
+
+    vector<int> input(length, 7), output(length, 0);
+
+    auto src = CLBuffer<int>::Create(this->context, CLFlags::RO, length);
+    auto dst = CLBuffer<int>::Create(this->context, CLFlags::WO, length);
+    ASSERT(src);
+    ASSERT(dst);
+
+    auto copy = CLKernel::Create(this->program, "copyIntArray");
+    ASSERT(copy);
+
+    copy.Args(src, dst);
+    copy.Size({ length });
+
+    // Event-less objects still report to the tracer.
+    copy.Eventless(true);
+
+    if (!src.Write(queue, input.data()) || !copy.Execute(queue) || !dst.Read(queue, &output[0]) || output != input)
+    {
+        return -1;
+    }
+
+    auto map = dst.Map(queue, CLFlags::RO);
+    if (!map)
+    {
+        return -1;
+    }
+    map.Unmap();
+
+    auto done = queue.Marker();
+    done.Wait();
+
+    if (6 != tracer.Records())
+    {
+        return -1;
+    }
+
+    // Profiling results arrive through completion callbacks.
+    string json;
+    for (int i = 0; i < 100; i++)
+    {
+        json = tracer.Json();
+        if (json.find("copyIntArray\",\"cat\":\"device\"") != string::npos)
+        {
+            break;
+        }
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+
+    if (json.find("\"traceEvents\"") == string::npos ||
+        json.find("copyIntArray\",\"cat\":\"host\"") == string::npos ||
+        json.find("copyIntArray\",\"cat\":\"device\"") == string::npos ||
+        json.find("\"bytes\":4096") == string::npos)
+    {
+        return -1;
+    }
+
+    if (!tracer.Write("trace.json"))
+    {
+        return -1;
+    }
+
+    tracer.Detach(queue);
+    if (!src.Write(queue, input.data()) || 6 != tracer.Records())
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+int Test::QueueCounters()
+{
+    if (!*this)
+    {
+        return -1;
+    }
+
+    auto before = CLCounters::Global().Snapshot();
+
+    if (!this->CreateProgram())
+    {
+        return -1;
+    }
+
+    const size_t length = 1024;
+
+    vector<int> input(length, 3), output(length, 0);
+
+    auto src = CLBuffer<int>::Create(this->context, CLFlags::RO, length);
+    auto dst = CLBuffer<int>::Create(this->context, CLFlags::WO, length);
+    ASSERT(src);
+    ASSERT(dst);
+
+    auto copy = CLKernel::Create(this->program, "copyIntArray");
+    ASSERT(copy);
+
+    copy.Args(src, dst);
+    copy.Size({ length });
+
+    // Synchronous overloads wait once each.
+    for (int i = 0; i < 2; i++)
+    {
+        if (!src.Write(this->queue, input.data()) || !copy.Execute(this->queue) || !dst.Read(this->queue, &output[0]) || output != input)
+        {
+            return -1;
+        }
+    }
+
+    auto map = dst.Map(this->queue, CLFlags::RO);
+    if (!map)
+    {
+        return -1;
+    }
+    map.Unmap();
+
+    auto delta = CLCounters::Global().Snapshot() - before;
+
+    if (1 != delta.Builds ||
+        2 != delta.Enqueues[CLOp::Write] || 2 * length * sizeof(int) != delta.Bytes[CLOp::Write] ||
+        2 != delta.Enqueues[CLOp::Read]  || 2 * length * sizeof(int) != delta.Bytes[CLOp::Read]  ||
+        2 != delta.Enqueues[CLOp::Kernel] || 2 != delta.Launches["copyIntArray"] ||
+        1 != delta.Enqueues[CLOp::Map]   || length * sizeof(int) != delta.Bytes[CLOp::Map] ||
+        1 != delta.Enqueues[CLOp::Unmap])
+    {
+        return -1;
+    }
+
+    // Write, Execute and Read twice, then Map and Unmap.
+    if (8 != delta.Waits)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+int Test::QueueLatency()
+{
+    if (!*this || !this->CreateProgram())
+    {
+        return -1;
+    }
+
+    // Reported values stay within the bucket precision.
+    CLHistogram histogram;
+    for (uint64_t ns = 1; ns <= 10000; ns++)
+    {
+        histogram.Record(ns);
+    }
+
+    auto p50 = histogram.Percentile(50);
+    if (10000 != histogram.Count() || 10000 != histogram.Percentile(100) || p50 < 5000 || p50 > 5000 * 1.016)
+    {
+        return -1;
+    }
+
+    CLQueueOptions options;
+    options.Profiling = true;
+
+    auto queue = CLQueue::Create(this->context, nullptr, options);
+    if (!queue)
+    {
+        return -1;
+    }
+
+    const size_t length = 1024;
+    const int rounds = 50;
+
+    vector<int> input(length, 5);
+
+    auto src = CLBuffer<int>::Create(this->context, CLFlags::RO, length);
+    auto dst = CLBuffer<int>::Create(this->context, CLFlags::WO, length);
+    ASSERT(src);
+    ASSERT(dst);
+
+    auto copy = CLKernel::Create(this->program, "copyIntArray");
+    ASSERT(copy);
+
+    copy.Args(src, dst);
+    copy.Size({ length });
+    copy.Eventless(true);
+
+    CLLatency::Global().Enable(true);
+    ONCLEANUP(latency, []{ CLLatency::Global().Enable(false); });
+
+    if (!src.Write(queue, input.data()))
+    {
+        return -1;
+    }
+
+    for (int i = 0; i < rounds; i++)
+    {
+        if (!copy.Execute(queue))
+        {
+            return -1;
+        }
+    }
+
+    // Completion callbacks may still be running after the last wait returned.
+    auto& kernel = CLLatency::Global().Find(CLOp::Kernel, "copyIntArray");
+    for (int i = 0; i < 100 && (kernel.Host.Count() < rounds || kernel.Device.Count() < rounds); i++)
+    {
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+
+    if (rounds != kernel.Host.Count() || rounds != kernel.Device.Count() || 1 != CLLatency::Global().Find(CLOp::Write).Host.Count())
+    {
+        return -1;
+    }
+
+    for (auto histogram : { &kernel.Host, &kernel.Device })
+    {
+        auto p50  = histogram->Percentile(50);
+        auto p99  = histogram->Percentile(99);
+        auto p999 = histogram->Percentile(99.9);
+        if (!p50 || p50 > p99 || p99 > p999 || p999 > histogram->Max())
+        {
+            return -1;
+        }
+    }
+
+    CLLatency::Global().Reset();
+    if (kernel.Host.Count() || kernel.Device.Percentile(99))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+int Test::ReactorComplete()
+{
+    if (!*this)
+    {
+        return -1;
+    }
+
+    const size_t length = 1024;
+    const size_t reads  = 64;
+
+    auto buf = CLBuffer<int>::Create(this->context, CLFlags::RW, length);
+    ASSERT(buf);
+
+    if (!buf.Write(this->queue, vector<int>(length, 7).data()))
+    {
+        return -1;
+    }
+
+    atomic<int> direct(0);
+    if (CL_SUCCESS != buf.Event().OnComplete([&](cl_int status){ direct = CL_COMPLETE == status ? 1 : -1; }))
+    {
+        return -1;
+    }
+
+    vector<vector<int>> results(reads, vector<int>(length, 0));
+    atomic<size_t> verified(0);
+
+    {
+        CLReactor reactor(4);
+
+        for (size_t i = 0; i < reads; i++)
+        {
+            if (!buf.Read(this->queue, &results[i][0], {}))
+            {
+                return -1;
+            }
+
+            auto& result = results[i];
+            if (CL_SUCCESS != reactor.Post(buf, [&](cl_int status)
+            {
+                if (CL_COMPLETE != status)
+                {
+                    return;
+                }
+
+                for (auto v : result)
+                {
+                    if (7 != v)
+                    {
+                        return;
+                    }
+                }
+                verified++;
+            }))
+            {
+                return -1;
+            }
+        }
+        this->queue.Finish();
+
+        reactor.Drain();
+        if (reactor.Pending())
+        {
+            return -1;
+        }
+    }
+
+    return reads == verified && 1 == direct ? 0 : -1;
+}
+
+bool Test::CreateProgram()
+{
+    if (this->program)
+    {
+        return true;
     }
 
     string log;
-    this->program = CLProgram::Create(this->context, string(istreambuf_iterator<char>(file), istreambuf_iterator<char>()).c_str(), "", log);
+    this->program = CLProgram::Create(this->context, program_cl, "", log);
 
     return !!this->program;
 }
\ No newline at end of file
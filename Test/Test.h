@@ -4,6 +4,7 @@
 #include "CLFlags.h"
 #include "CLProgram.h"
 #include "CLQueue.h"
+#include <atomic>
 
 class Test
 {
@@ -22,10 +23,34 @@ public:
     int KernelExecute();
     int KernelBtsort();
     int KernelSumup();
+    int KernelVariants();
+    int KernelVector();
+    int KernelEventless();
+    int KernelZeroAlloc(const std::atomic<size_t>& allocations);
     int EventMapCopy();
     int EventReadWrite();
     int EventExecute();
+    int EventProfile();
+    int EventWaitPolicy();
+    int EventSet();
+    int EventUserGate();
     int ProgramBinary();
+    int ProgramKernels();
+    int ProgramBundle();
+    int ProgramCache();
+    int ProgramTune();
+    int ProgramAsync();
+    int ProgramLink();
+    int ProgramIL();
+    int MultiDeviceExecute();
+    int GraphExecute();
+    int HazardTrack();
+    int QueuePool();
+    int QueueMarker();
+    int QueueTrace();
+    int QueueCounters();
+    int QueueLatency();
+    int ReactorComplete();
 
     operator bool() const
     {
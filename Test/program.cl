@@ -5,22 +5,27 @@
 #define ELM2D(type, pointer, x, y)      (ROW2D(type, pointer, y)[x])
 #define ELM3D(type, pointer, x, y, z)   (ROW3D(type, pointer, y, z)[x])
 
-void swap(__global int* a, __global int* b)
+// Element type of btsort and sumup, bound per variant with -DT=<type>
+#ifndef T
+#define T int
+#endif
+
+void swap(__global T* a, __global T* b)
 {
-    *a = *a ^ *b;
-    *b = *a ^ *b;
-    *a = *a ^ *b;
+    T t = *a;
+    *a = *b;
+    *b = t;
 }
 
-__kernel void btsort(uint level, uint tsize, __global int* array)
+__kernel void btsort(uint level, uint tsize, __global T* array)
 {
     size_t tid = get_global_id(0);
     size_t lsz = 2 << level;
     size_t lid = tid * 2 / lsz;
     size_t idx = tid + lid * lsz / 2;
 
-    __global int* a = array + idx;
-    __global int* b = a + lsz / 2;
+    __global T* a = array + idx;
+    __global T* b = a + lsz / 2;
 
     size_t tone = (tid * 2 / tsize) % 2;
     if (( tone && *a < *b) ||
@@ -30,18 +35,18 @@ __kernel void btsort(uint level, uint tsize, __global int* array)
     }
 }
 
-__kernel void sumup(global const int* values,
+__kernel void sumup(global const T* values,
                                  uint PITCH(values),
                                  uint width,
                                  uint height,
-                    global       int* sumups,
-                    local        int* reduce)
+                    global       T* sumups,
+                    local        T* reduce)
 {
     size_t x = get_global_id(0);
     size_t y = get_global_id(1);
 
     size_t lid = get_local_id(1)  * get_local_size(0)  + get_local_id(0);
-    reduce[lid] = (x < width && y < height) ? ELM2D(int, values, x, y) : 0;
+    reduce[lid] = (x < width && y < height) ? ELM2D(T, values, x, y) : 0;
     barrier(CLK_LOCAL_MEM_FENCE);
 
     size_t lsz = get_local_size(0) * get_local_size(1);
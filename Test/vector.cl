@@ -0,0 +1,17 @@
+// Built through CLVector::Source() with T and VEC bound per variant.
+
+// y = a * x + y over count elements, VEC per work-item.
+__kernel void axpy(T a, __global const T* x, __global T* y, uint count)
+{
+    size_t i = get_global_id(0);
+    if (VFULL(i, count))
+    {
+        VSTORE(a * VLOAD(i, x) + VLOAD(i, y), i, y);
+        return;
+    }
+
+    for (size_t j = i * VEC; j < count; j++)
+    {
+        y[j] = a * x[j] + y[j];
+    }
+}
\ No newline at end of file